@@ -0,0 +1,252 @@
+#include <pthread.h>
+#include <unistd.h>
+#include "aggregate.h"
+
+#define KEY_WORDS (NAME_SIZE / 8)
+#define ONES 0x0101010101010101ULL
+#define HIGHS 0x8080808080808080ULL
+
+_Static_assert(NAME_SIZE == LOCATION_SIZE, "both group columns share one key layout");
+_Static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "keyWord finds the end of a value from the low byte up");
+
+// group is the index into groups plus one, 0 for an empty slot. tag is the
+// high half of the key's hash, the low bits pick the slot.
+typedef struct aggregateSlot {
+	uint32_t tag;
+	uint32_t group;
+} aggregateSlot;
+
+typedef struct aggregateTable {
+	aggregateSlot* slots;
+	uint32_t mask; // slots - 1, always a power of two
+	aggregateGroup* groups;
+	uint32_t numGroups;
+	uint32_t capacity;
+} aggregateTable;
+
+typedef struct aggregateWorker {
+	mmapReader* reader;
+	uint32_t first;
+	uint32_t end;
+	rowColumn groupBy;
+	const scanPredicate* predicates;
+	int numPredicates;
+	aggregateTable table;
+	size_t rows;
+} aggregateWorker;
+
+// word w of a value, with everything from its zero byte on cleared. Sets done
+// once the word holding the zero byte has been read.
+static inline uint64_t keyWord(const char* field, int w, bool* done){
+	uint64_t word;
+	memcpy(&word, field + w * 8, sizeof(uint64_t));
+	uint64_t zero = (word - ONES) & ~word & HIGHS;
+	if (zero){
+		*done = true;
+		int bytes = __builtin_ctzll(zero) / 8;
+		word &= bytes ? ~0ULL >> (64 - 8 * bytes) : 0;
+	}
+	return word;
+}
+
+static inline uint64_t keyHash(const char* field){
+	uint64_t hash = 0;
+	bool done = false;
+	for (int w = 0; w < KEY_WORDS && !done; w++){
+		hash = (hash ^ keyWord(field, w, &done)) * 0x9e3779b97f4a7c15ULL;
+		hash ^= hash >> 29;
+	}
+	return hash;
+}
+
+// group keys are zero padded, so a value shorter or longer than the key
+// differs from it in the word where the shorter one ends
+static inline bool keyEquals(const char* field, const char* key){
+	bool done = false;
+	for (int w = 0; w < KEY_WORDS && !done; w++){
+		uint64_t word;
+		memcpy(&word, key + w * 8, sizeof(uint64_t));
+		if (keyWord(field, w, &done) != word){
+			return false;
+		}
+	}
+	return true;
+}
+
+static void tableInit(aggregateTable* table){
+	table->slots = calloc(AGGREGATE_INITIAL_SLOTS, sizeof(aggregateSlot));
+	table->mask = AGGREGATE_INITIAL_SLOTS - 1;
+	table->capacity = AGGREGATE_INITIAL_SLOTS / 2;
+	table->groups = malloc(table->capacity * sizeof(aggregateGroup));
+	table->numGroups = 0;
+	if (table->slots == NULL || table->groups == NULL){
+		printf("error allocating the aggregate table exiting..");
+		exit(1);
+	}
+}
+
+static void tableFree(aggregateTable* table){
+	free(table->slots);
+	free(table->groups);
+}
+
+// doubles the slots once they are half full, the groups stay where they are
+// and only the slots are rehashed
+static void tableGrow(aggregateTable* table){
+	uint32_t numSlots = (table->mask + 1) * 2;
+	aggregateSlot* slots = calloc(numSlots, sizeof(aggregateSlot));
+	aggregateGroup* groups = realloc(table->groups, numSlots / 2 * sizeof(aggregateGroup));
+	if (slots == NULL || groups == NULL){
+		printf("error growing the aggregate table exiting..");
+		exit(1);
+	}
+	table->groups = groups;
+	table->mask = numSlots - 1;
+	table->capacity = numSlots / 2;
+	for (uint32_t g = 0; g < table->numGroups; g++){
+		uint64_t hash = keyHash(groups[g].key);
+		uint32_t i = (uint32_t)hash & table->mask;
+		while (slots[i].group != 0){
+			i = (i + 1) & table->mask;
+		}
+		slots[i] = (aggregateSlot){(uint32_t)(hash >> 32), g + 1};
+	}
+	free(table->slots);
+	table->slots = slots;
+}
+
+// the group for field, added with empty aggregates if it isn't there yet
+static inline aggregateGroup* tableFind(aggregateTable* table, const char* field, uint64_t hash){
+	uint32_t tag = (uint32_t)(hash >> 32);
+	uint32_t i = (uint32_t)hash & table->mask;
+	while (table->slots[i].group != 0){
+		aggregateGroup* group = &table->groups[table->slots[i].group - 1];
+		if (table->slots[i].tag == tag && keyEquals(field, group->key)){
+			return group;
+		}
+		i = (i + 1) & table->mask;
+	}
+	if (table->numGroups == table->capacity){
+		tableGrow(table);
+		return tableFind(table, field, hash);
+	}
+	aggregateGroup* group = &table->groups[table->numGroups++];
+	table->slots[i] = (aggregateSlot){tag, table->numGroups};
+	memset(group->key, 0, sizeof(group->key));
+	bool done = false;
+	for (int w = 0; w < KEY_WORDS && !done; w++){
+		uint64_t word = keyWord(field, w, &done);
+		memcpy(group->key + w * 8, &word, sizeof(uint64_t));
+	}
+	group->count = 0;
+	group->sum = 0;
+	group->min = INT64_MAX;
+	group->max = INT64_MIN;
+	return group;
+}
+
+// Hashes the whole batch first and prefetches each row's slot, so with many
+// groups the probes don't wait on one cache miss after another.
+static bool aggregateBatch(const scanBatch* batch, const uint16_t* selected, uint32_t numSelected, void* arg){
+	aggregateWorker* worker = arg;
+	aggregateTable* table = &worker->table;
+	const char* const* fields = worker->groupBy == COLUMN_NAME ? batch->names : batch->locations;
+	uint64_t hashes[SCAN_BATCH_ROWS];
+	for (uint32_t i = 0; i < numSelected; i++){
+		hashes[i] = keyHash(fields[selected[i]]);
+		__builtin_prefetch(&table->slots[(uint32_t)hashes[i] & table->mask]);
+	}
+	for (uint32_t i = 0; i < numSelected; i++){
+		aggregateGroup* group = tableFind(table, fields[selected[i]], hashes[i]);
+		int64_t id = batch->ids[selected[i]];
+		group->count++;
+		group->sum += id;
+		group->min = id < group->min ? id : group->min;
+		group->max = id > group->max ? id : group->max;
+	}
+	worker->rows += numSelected;
+	return true;
+}
+
+static void* aggregateRange(void* arg){
+	aggregateWorker* worker = arg;
+	scanFilterPages(worker->reader, worker->first, worker->end, worker->predicates, worker->numPredicates,
+		aggregateBatch, worker);
+	return NULL;
+}
+
+// folds every group of from into into
+static void tableMerge(aggregateTable* into, const aggregateTable* from){
+	for (uint32_t g = 0; g < from->numGroups; g++){
+		const aggregateGroup* partial = &from->groups[g];
+		aggregateGroup* group = tableFind(into, partial->key, keyHash(partial->key));
+		group->count += partial->count;
+		group->sum += partial->sum;
+		group->min = partial->min < group->min ? partial->min : group->min;
+		group->max = partial->max > group->max ? partial->max : group->max;
+	}
+}
+
+int aggregateDefaultThreads(){
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cores < 1){
+		return 1;
+	}
+	return cores < AGGREGATE_MAX_THREADS ? cores : AGGREGATE_MAX_THREADS;
+}
+
+// Groups the rows of the file that pass every predicate by groupBy (name or
+// location). The groups are the caller's to free with aggregateResultFree.
+aggregateResult aggregateBy(mmapReader* reader, rowColumn groupBy, const scanPredicate* predicates,
+	int numPredicates, int numThreads){
+	uint32_t numPages = mmapReaderPages(reader);
+	int numRanges = numPages / AGGREGATE_MIN_PAGES;
+	if (numRanges > numThreads){
+		numRanges = numThreads;
+	}
+	if (numRanges > AGGREGATE_MAX_THREADS){
+		numRanges = AGGREGATE_MAX_THREADS;
+	}
+	if (numRanges < 1){
+		numRanges = 1;
+	}
+	aggregateWorker workers[AGGREGATE_MAX_THREADS];
+	for (int i = 0; i < numRanges; i++){
+		workers[i] = (aggregateWorker){reader, (uint64_t)numPages * i / numRanges,
+			(uint64_t)numPages * (i + 1) / numRanges, groupBy, predicates, numPredicates, {0}, 0};
+		tableInit(&workers[i].table);
+	}
+
+	pthread_t threads[AGGREGATE_MAX_THREADS];
+	bool started[AGGREGATE_MAX_THREADS] = {false};
+	for (int i = 1; i < numRanges; i++){
+		started[i] = pthread_create(&threads[i], NULL, aggregateRange, &workers[i]) == 0;
+		if (!started[i]){
+			aggregateRange(&workers[i]);
+		}
+	}
+	aggregateRange(&workers[0]);
+	for (int i = 1; i < numRanges; i++){
+		if (started[i]){
+			pthread_join(threads[i], NULL);
+		}
+	}
+
+	// the merge only sees one entry per group per thread, not one per row. New
+	// groups are appended range by range, so they stay in file order.
+	size_t rows = workers[0].rows;
+	for (int i = 1; i < numRanges; i++){
+		tableMerge(&workers[0].table, &workers[i].table);
+		rows += workers[i].rows;
+		tableFree(&workers[i].table);
+	}
+	aggregateResult result = {workers[0].table.groups, workers[0].table.numGroups, rows, numRanges};
+	free(workers[0].table.slots);
+	return result;
+}
+
+void aggregateResultFree(aggregateResult* result){
+	free(result->groups);
+	result->groups = NULL;
+	result->numGroups = 0;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <stdbool.h>
+#include "db.h"
+#include "mmapReader.h"
+#include "scan.h"
+
+#define AGGREGATE_MAX_THREADS 8
+#define AGGREGATE_MIN_PAGES 256 // fewer pages per thread aren't worth starting it
+#define AGGREGATE_INITIAL_SLOTS 1024
+
+// GROUP BY name or location with COUNT, MIN, MAX and SUM of id, over a
+// scanFilter scan so a WHERE on any column comes for free. The pages are cut
+// into one range per thread and every thread aggregates its rows into its own
+// hash table, nothing is shared until the tables are merged at the end.
+// The tables use open addressing with linear probing: each slot is 8 bytes,
+// part of the key's hash and the index of its group in a dense array, so a
+// probe reads one cache line of slots and only touches a group when the
+// hashes agree. Group keys are compared and hashed eight bytes at a time.
+
+typedef struct aggregateGroup {
+	char key[NAME_SIZE]; // the name or location, zero padded
+	int64_t count;
+	int64_t sum; // of id
+	int64_t min;
+	int64_t max;
+} aggregateGroup;
+
+typedef struct aggregateResult {
+	aggregateGroup* groups; // in the order each value first appears in the file
+	size_t numGroups;
+	size_t rows;            // rows that passed the predicates
+	int threads;            // threads the scan was split over
+} aggregateResult;
+
+int aggregateDefaultThreads();
+aggregateResult aggregateBy(mmapReader* reader, rowColumn groupBy, const scanPredicate* predicates,
+	int numPredicates, int numThreads);
+void aggregateResultFree(aggregateResult* result);
@@ -0,0 +1,1105 @@
+// Micro benchmarks for the storage layer, built with `make bench`.
+//
+//   ./bench lookup [maxRows]   point lookup latency as the table grows
+//   ./bench parse file.csv     CSV parse throughput, old fgets/strtok loop vs csvParse
+//   ./bench bptree [numKeys]   in-memory bptree.h insert and teardown time
+//   ./bench compare [numKeys]  bptree_get with the inlined key compare vs a comparator pointer
+//   ./bench search             bptree_get per tree height, SIMD node search vs scalar
+//   ./bench concurrent [keys]  lookup throughput by reader count with an insert running
+//   ./bench olc [numKeys]      concurrent gets and puts stress test, checks every key and the invariants
+//   ./bench batch [numKeys]    bptree_put per key vs bptree_put_batch in 1024 key batches
+//   ./bench where [numRows]    lookups by name and location, scan vs secondary index
+//   ./bench range [numRows]    id range reads, a retrieve per id vs the leaf chain and merged reads
+//   ./bench pax [numRows]      scans of one column and of whole rows, slotted pages vs PAX pages
+//   ./bench scan [numRows]     filter scans, a row at a time vs scanFilter with scalar and SIMD kernels
+//   ./bench group [numRows]    GROUP BY location and name throughput by thread count
+//   ./bench nodes [numKeys]    insert, lookup and range scan speed by bptree node size
+//   ./bench snapshot [numKeys] insert throughput while full scans run under a lock vs on snapshots
+//
+// Every benchmark works on its own files (bench_*.bin) and removes them when
+// it is done, dbFile.bin and index.bin are never touched.
+#include <inttypes.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include "db.h"
+#include "page.h"
+#include "pageIndex.h"
+#include "retrieve.h"
+#include "csvParse.h"
+#include "bptree.h"
+#include "secondaryIndex.h"
+#include "mmapReader.h"
+#include "scan.h"
+#include "aggregate.h"
+
+#define BENCH_BPTREE_MAX_KEYS 64
+#define BENCH_MAX_READERS 16
+#define BENCH_CONCURRENT_SECONDS 0.5
+#define BENCH_SCAN_KEYS 1000
+#define BENCH_WHERE_ROWS 20 // rows read back per lookup, what the shell's find prints
+
+#define BENCH_DB "bench_dbFile.bin"
+#define BENCH_INDEX "bench_index.bin"
+
+static double nowSeconds(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// xorshift, rand() is too slow and too short for 100M rows
+static uint64_t nextRandom(uint64_t* state){
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+static void fillRow(struct Row* row, int64_t id){
+	memset(row, 0, sizeof(struct Row));
+	row->id = id;
+	snprintf(row->name, NAME_SIZE, "User%ld", id);
+	snprintf(row->location, LOCATION_SIZE, "City%ld", id % 50);
+}
+
+// writes ids 1..numRows straight into pages of the given format and the paged index
+static void buildTableFormat(int db, pageIndex* index, int64_t numRows, uint16_t format){
+	char page[PAGE_SIZE];
+	uint32_t page_id = 0;
+	struct Row row;
+	pageInitFormat(page, format);
+	for (int64_t id = 1; id <= numRows; id++){
+		if (!pageHasRoom(page, sizeof(struct Row))){
+			writeDataPage(db, page_id++, page);
+			pageInitFormat(page, format);
+		}
+		fillRow(&row, id);
+		rowLocator loc = {page_id, pageNextOffset(page, sizeof(struct Row))};
+		pageInsertRow(page, &row, sizeof(struct Row));
+		pageIndexPut(index, id, loc);
+	}
+	writeDataPage(db, page_id, page);
+	pageIndexFlush(index);
+}
+
+static void buildTable(int db, pageIndex* index, int64_t numRows){
+	buildTableFormat(db, index, numRows, DATA_PAGE_FORMAT);
+}
+
+// how retrieve read a row before it went through the mapping, one pread of
+// the row or of its whole page for PAX
+static bool preadRow(int db, pageIndex* index, int64_t id, struct Row* dOut){
+	rowLocator loc;
+	if (!pageIndexGet(index, id, &loc)){
+		return false;
+	}
+	if (loc.offset & PAX_ROW_FLAG){
+		char page[PAGE_SIZE];
+		readDataPage(db, loc.page_id, page);
+		pageReadRow(page, loc.offset, dOut);
+		return true;
+	}
+	off_t pos = (off_t)loc.page_id * PAGE_SIZE + loc.offset;
+	return pread(db, dOut, sizeof(struct Row), pos) == sizeof(struct Row);
+}
+
+static void benchLookup(int64_t maxRows){
+	const int lookups = 200000;
+	printf("%12s %8s %12s %12s %14s \n", "rows", "height", "pread ns", "mmap ns", "lookups/sec");
+	for (int64_t numRows = 10000; numRows <= maxRows; numRows *= 10){
+		unlink(BENCH_DB);
+		unlink(BENCH_INDEX);
+		bufferPool* pool = bufferPoolCreate(BUFFER_POOL_BYTES);
+		int db = openDataFile(BENCH_DB);
+		pageIndex* index = pageIndexOpen(BENCH_INDEX, pool);
+		buildTable(db, index, numRows);
+		mmapReader* reader = mmapReaderOpen(db, MMAP_RANDOM);
+
+		// a pass of each path first so neither is timed with cold index pages
+		double nsPerLookup[2];
+		for (int pass = 0; pass < 4; pass++){
+			bool mapped = pass % 2;
+			uint64_t state = 88172645463325252ULL;
+			struct Row row;
+			int found = 0;
+			double start = nowSeconds();
+			for (int i = 0; i < lookups; i++){
+				int64_t id = 1 + nextRandom(&state) % numRows;
+				found += mapped ? retrieve(reader, index, id, &row) : preadRow(db, index, id, &row);
+			}
+			nsPerLookup[mapped] = (nowSeconds() - start) * 1e9 / lookups;
+			if (found != lookups){
+				printf("only found %d of %d ids \n", found, lookups);
+			}
+		}
+		printf("%12ld %8u %12.0f %12.0f %14.0f \n", numRows, index->meta.height, nsPerLookup[0],
+			nsPerLookup[1], 1e9 / nsPerLookup[1]);
+
+		mmapReaderClose(reader);
+		pageIndexClose(index);
+		close(db);
+		bufferPoolFree(pool);
+	}
+	unlink(BENCH_DB);
+	unlink(BENCH_INDEX);
+}
+
+// the parser ingest used before csvParse, kept here as the baseline
+static size_t parseWithStrtok(FILE* csv, struct Row* rows){
+	char line[1024];
+	size_t count = 0;
+	while (fgets(line, sizeof(line), csv)){
+		rows[count].id = strtol(strtok(line, ","), NULL, 10);
+		strcpy(rows[count].name, strtok(NULL, ","));
+		strcpy(rows[count].location, strtok(NULL, ","));
+		count++;
+	}
+	return count;
+}
+
+// The file is read into memory first so only parsing is timed. memcpy of the
+// same bytes is printed as the memory bandwidth ceiling.
+static void benchParse(char* filePath){
+	FILE* csv = fopen(filePath, "rb");
+	if (csv == NULL){
+		printf("could not open %s \n", filePath);
+		exit(1);
+	}
+	fseek(csv, 0, SEEK_END);
+	size_t len = ftell(csv);
+	fseek(csv, 0, SEEK_SET);
+	char* input = calloc(len + CSV_PADDING, 1);
+	char* copy = malloc(len);
+	if (input == NULL || copy == NULL || fread(input, 1, len, csv) != len){
+		printf("could not read %s \n", filePath);
+		exit(1);
+	}
+	fclose(csv);
+	size_t numLines = 0;
+	for (size_t i = 0; i < len; i++){
+		numLines += input[i] == '\n';
+	}
+	double mb = len / 1e6;
+	printf("%zu bytes, %zu lines, %d cores \n", len, numLines, csvDefaultThreads());
+	printf("%-16s %10s %10s \n", "parser", "ms", "MB/s");
+
+	memcpy(copy, input, len);
+	double start = nowSeconds();
+	memcpy(copy, input, len);
+	double elapsed = nowSeconds() - start;
+	printf("%-16s %10.1f %10.0f \n", "memcpy", elapsed * 1e3, mb / elapsed);
+
+	struct Row* rows = malloc((numLines + 1) * sizeof(struct Row));
+	FILE* memCsv = fmemopen(copy, len, "r");
+	start = nowSeconds();
+	size_t parsed = parseWithStrtok(memCsv, rows);
+	elapsed = nowSeconds() - start;
+	fclose(memCsv);
+	printf("%-16s %10.1f %10.0f (%zu rows) \n", "fgets+strtok", elapsed * 1e3, mb / elapsed, parsed);
+	free(rows);
+
+	for (int threads = 1; threads <= CSV_MAX_THREADS; threads *= 2){
+		csvParser* parser = csvParserCreate(threads);
+		// the first pass grows the row buffers, ingest reuses them chunk after chunk
+		csvParse(parser, input, len);
+		start = nowSeconds();
+		csvParse(parser, input, len);
+		elapsed = nowSeconds() - start;
+		parsed = 0;
+		for (int r = 0; r < parser->numRanges; r++){
+			parsed += parser->ranges[r].numRows + parser->ranges[r].malformed;
+		}
+		char name[32];
+		snprintf(name, sizeof(name), "csvParse x%d", threads);
+		printf("%-16s %10.1f %10.0f (%zu rows) \n", name, elapsed * 1e3, mb / elapsed, parsed);
+		csvParserFree(parser);
+	}
+	free(input);
+	free(copy);
+}
+
+// Node allocation happens on every split and every node is released in
+// bptree_free, so the put and free columns are where allocator cost shows.
+static void benchBptree(int64_t numKeys){
+	printf("%-12s %12s %12s %12s %10s \n", "keys", "put ms", "ns/put", "free ms", "nodes");
+	const char* orders[] = {"ascending", "random"};
+	for (int order = 0; order < 2; order++){
+		bptree* tree = bptree_create(BENCH_BPTREE_MAX_KEYS, NULL, false);
+		uint64_t state = 88172645463325252ULL;
+		double start = nowSeconds();
+		for (int64_t i = 0; i < numKeys; i++){
+			bptree_key_t key = order == 0 ? i : (int64_t)(nextRandom(&state) >> 1);
+			rowLocator loc = {(uint32_t)(i / ROWS_PER_PAGE), (uint32_t)(i % ROWS_PER_PAGE)};
+			bptree_put(tree, &key, loc);
+		}
+		double putElapsed = nowSeconds() - start;
+		int nodes = bptree_get_stats(tree).node_count;
+		start = nowSeconds();
+		bptree_free(tree);
+		double freeElapsed = nowSeconds() - start;
+		printf("%-12s %12.0f %12.1f %12.1f %10d \n", orders[order], putElapsed * 1e3,
+			putElapsed * 1e9 / numKeys, freeElapsed * 1e3, nodes);
+	}
+}
+
+// same ordering as the default, but passing it makes the tree call through the pointer
+static int pointerCompare(const bptree_key_t* a, const bptree_key_t* b){
+	return (*a < *b) ? -1 : ((*a > *b) ? 1 : 0);
+}
+
+static void benchCompare(int64_t numKeys){
+	const int lookups = 2000000;
+	bptree_key_t* keys = malloc(numKeys * sizeof(bptree_key_t));
+	rowLocator* values = malloc(numKeys * sizeof(rowLocator));
+	for (int64_t i = 0; i < numKeys; i++){
+		keys[i] = i * 2;
+		values[i] = (rowLocator){(uint32_t)(i / ROWS_PER_PAGE), (uint32_t)(i % ROWS_PER_PAGE)};
+	}
+	printf("%-10s %12s %12s \n", "compare", "ns/get", "gets/sec");
+	const char* names[] = {"inlined", "pointer"};
+	for (int variant = 0; variant < 2; variant++){
+		bptree* tree = bptree_create(BENCH_BPTREE_MAX_KEYS, variant == 0 ? NULL : pointerCompare, false);
+		bptree_bulk_load(tree, keys, values, numKeys, 1.0);
+		uint64_t state = 88172645463325252ULL;
+		int found = 0;
+		rowLocator loc;
+		double start = nowSeconds();
+		for (int i = 0; i < lookups; i++){
+			// odd keys miss, so both outcomes are timed
+			bptree_key_t key = nextRandom(&state) % (numKeys * 2);
+			found += bptree_get(tree, &key, &loc) == BPTREE_OK;
+		}
+		double elapsed = nowSeconds() - start;
+		printf("%-10s %12.1f %12.0f (%d found) \n", names[variant], elapsed * 1e9 / lookups,
+			lookups / elapsed, found);
+		bptree_free(tree);
+	}
+	free(keys);
+	free(values);
+}
+
+// Nodes are filled to a page so every level is a long search, one tree per height.
+static void benchSearch(){
+	const int lookups = 2000000;
+	const int64_t sizes[] = {200, 50000, 10000000};
+	printf("%-8s %12s %12s %14s %14s \n", "height", "keys", "scalar ns", "simd ns", "simd ns/level");
+	for (int s = 0; s < 3; s++){
+		int64_t numKeys = sizes[s];
+		bptree_key_t* keys = malloc(numKeys * sizeof(bptree_key_t));
+		rowLocator* values = malloc(numKeys * sizeof(rowLocator));
+		for (int64_t i = 0; i < numKeys; i++){
+			keys[i] = i * 2;
+			values[i] = (rowLocator){(uint32_t)(i / ROWS_PER_PAGE), (uint32_t)(i % ROWS_PER_PAGE)};
+		}
+		bptree* tree = bptree_create(bptree_max_keys_for_size(PAGE_SIZE), NULL, false);
+		bptree_bulk_load(tree, keys, values, numKeys, 1.0);
+		double nsPerGet[2];
+		for (int simd = 0; simd < 2; simd++){
+			bptree_use_simd(simd);
+			uint64_t state = 88172645463325252ULL;
+			rowLocator loc;
+			int found = 0;
+			double start = nowSeconds();
+			for (int i = 0; i < lookups; i++){
+				bptree_key_t key = nextRandom(&state) % (numKeys * 2);
+				found += bptree_get(tree, &key, &loc) == BPTREE_OK;
+			}
+			nsPerGet[simd] = (nowSeconds() - start) * 1e9 / lookups;
+			if (found == 0){
+				printf("no lookups hit \n");
+			}
+		}
+		printf("%-8d %12ld %12.1f %14.1f %14.1f \n", tree->height, numKeys, nsPerGet[0], nsPerGet[1],
+			nsPerGet[1] / tree->height);
+		bptree_free(tree);
+		free(keys);
+		free(values);
+	}
+	bptree_use_simd(true);
+}
+
+typedef struct concurrentRun {
+	bptree* tree;
+	int64_t numKeys;
+	bool useMutex; // baseline: every call behind one lock, as the tree needed before
+	pthread_mutex_t lock;
+	volatile bool stop;
+} concurrentRun;
+
+typedef struct concurrentWorker {
+	concurrentRun* run;
+	uint64_t seed;
+	uint64_t ops;
+	pthread_t thread;
+} concurrentWorker;
+
+static void* concurrentReader(void* arg){
+	concurrentWorker* worker = arg;
+	concurrentRun* run = worker->run;
+	uint64_t state = worker->seed;
+	rowLocator loc;
+	while (!run->stop){
+		bptree_key_t key = (nextRandom(&state) % run->numKeys) * 2;
+		if (run->useMutex){
+			pthread_mutex_lock(&run->lock);
+			bptree_get(run->tree, &key, &loc);
+			pthread_mutex_unlock(&run->lock);
+		}
+		else{
+			bptree_get_concurrent(run->tree, &key, &loc);
+		}
+		worker->ops++;
+	}
+	return NULL;
+}
+
+// inserts the odd keys, so lookups of the even ones never change their answer
+static void* concurrentWriter(void* arg){
+	concurrentWorker* worker = arg;
+	concurrentRun* run = worker->run;
+	for (int64_t i = 0; !run->stop; i++){
+		bptree_key_t key = i * 2 + 1;
+		rowLocator loc = {(uint32_t)(i / ROWS_PER_PAGE), (uint32_t)(i % ROWS_PER_PAGE)};
+		if (run->useMutex){
+			pthread_mutex_lock(&run->lock);
+			bptree_put(run->tree, &key, loc);
+			pthread_mutex_unlock(&run->lock);
+		}
+		else{
+			bptree_put_concurrent(run->tree, &key, loc);
+		}
+		worker->ops++;
+	}
+	return NULL;
+}
+
+static void benchConcurrent(int64_t numKeys){
+	bptree_key_t* keys = malloc(numKeys * sizeof(bptree_key_t));
+	rowLocator* values = malloc(numKeys * sizeof(rowLocator));
+	for (int64_t i = 0; i < numKeys; i++){
+		keys[i] = i * 2;
+		values[i] = (rowLocator){(uint32_t)(i / ROWS_PER_PAGE), (uint32_t)(i % ROWS_PER_PAGE)};
+	}
+	printf("%d cores, one writer running throughout \n", csvDefaultThreads());
+	printf("%-8s %-8s %14s %14s \n", "readers", "latch", "gets/sec", "puts/sec");
+	for (int readers = 1; readers <= BENCH_MAX_READERS; readers *= 2){
+		for (int useMutex = 1; useMutex >= 0; useMutex--){
+			concurrentRun run = {.numKeys = numKeys, .useMutex = useMutex, .stop = false};
+			run.tree = bptree_create(BENCH_BPTREE_MAX_KEYS, NULL, false);
+			bptree_bulk_load(run.tree, keys, values, numKeys, 1.0);
+			pthread_mutex_init(&run.lock, NULL);
+			concurrentWorker workers[BENCH_MAX_READERS + 1];
+			for (int i = 0; i <= readers; i++){
+				workers[i] = (concurrentWorker){.run = &run, .seed = 88172645463325252ULL + i * 7919};
+				pthread_create(&workers[i].thread, NULL, i == readers ? concurrentWriter : concurrentReader,
+					&workers[i]);
+			}
+			usleep(BENCH_CONCURRENT_SECONDS * 1e6);
+			run.stop = true;
+			uint64_t gets = 0;
+			for (int i = 0; i <= readers; i++){
+				pthread_join(workers[i].thread, NULL);
+				gets += i < readers ? workers[i].ops : 0;
+			}
+			printf("%-8d %-8s %14.0f %14.0f \n", readers, useMutex ? "mutex" : "olc",
+				gets / BENCH_CONCURRENT_SECONDS, workers[readers].ops / BENCH_CONCURRENT_SECONDS);
+			pthread_mutex_destroy(&run.lock);
+			bptree_free(run.tree);
+		}
+	}
+	free(keys);
+	free(values);
+}
+
+#define BENCH_OLC_WRITERS 4
+#define BENCH_OLC_READERS 4
+
+typedef struct olcRun {
+	bptree* tree;
+	int64_t numKeys;  // preloaded, the even keys
+	int64_t perWriter; // odd keys each writer inserts
+	volatile bool stop;
+	uint64_t wrong;   // keys found with the wrong value or not found when they must be
+} olcRun;
+
+typedef struct olcWorker {
+	olcRun* run;
+	int index;
+	uint64_t seed;
+	uint64_t ops;
+	pthread_t thread;
+} olcWorker;
+
+// every key's value is worked out from the key, so any reader can check it
+static rowLocator olcValue(bptree_key_t key){
+	return (rowLocator){(uint32_t)(key / ROWS_PER_PAGE), (uint32_t)(key % ROWS_PER_PAGE)};
+}
+
+static bool olcFound(const bptree* tree, bptree_key_t key){
+	rowLocator loc;
+	rowLocator expected = olcValue(key);
+	return bptree_get_concurrent(tree, &key, &loc) == BPTREE_OK && loc.page_id == expected.page_id
+		&& loc.offset == expected.offset;
+}
+
+// a preloaded key must always be found, an inserted one may not be there yet
+// but if it is its value has to be right
+static void* olcReader(void* arg){
+	olcWorker* worker = arg;
+	olcRun* run = worker->run;
+	uint64_t state = worker->seed;
+	int64_t inserted = run->perWriter * BENCH_OLC_WRITERS;
+	uint64_t wrong = 0;
+	rowLocator loc;
+	while (!run->stop){
+		bptree_key_t key = (nextRandom(&state) % run->numKeys) * 2;
+		wrong += !olcFound(run->tree, key);
+		key = (nextRandom(&state) % inserted) * 2 + 1;
+		if (bptree_get_concurrent(run->tree, &key, &loc) == BPTREE_OK){
+			wrong += loc.page_id != olcValue(key).page_id || loc.offset != olcValue(key).offset;
+		}
+		worker->ops += 2;
+	}
+	__atomic_add_fetch(&run->wrong, wrong, __ATOMIC_RELAXED);
+	return NULL;
+}
+
+// writer w inserts the odd keys 2 * (i * writers + w) + 1, interleaved with
+// the others so they keep splitting the same leaves
+static void* olcWriter(void* arg){
+	olcWorker* worker = arg;
+	olcRun* run = worker->run;
+	uint64_t wrong = 0;
+	for (int64_t i = 0; i < run->perWriter; i++){
+		bptree_key_t key = (i * BENCH_OLC_WRITERS + worker->index) * 2 + 1;
+		wrong += bptree_put_concurrent(run->tree, &key, olcValue(key)) != BPTREE_OK;
+		worker->ops++;
+	}
+	__atomic_add_fetch(&run->wrong, wrong, __ATOMIC_RELAXED);
+	return NULL;
+}
+
+// Stress test for bptree_get_concurrent and bptree_put_concurrent: 4 writers
+// insert disjoint keys while 4 readers check values, then every key is read
+// back and the tree's invariants are checked. Exits 1 if anything is off.
+static void benchOlc(int64_t numKeys){
+	if (numKeys < BENCH_OLC_WRITERS){
+		printf("error olc needs at least %d keys exiting..", BENCH_OLC_WRITERS);
+		exit(1);
+	}
+	int maxKeys[] = {3, 4, 8, 64, 254};
+	bptree_key_t* keys = malloc(numKeys * sizeof(bptree_key_t));
+	rowLocator* values = malloc(numKeys * sizeof(rowLocator));
+	for (int64_t i = 0; i < numKeys; i++){
+		keys[i] = i * 2;
+		values[i] = olcValue(keys[i]);
+	}
+	bool failed = false;
+	printf("%d writers and %d readers, %ld keys preloaded and %ld inserted \n", BENCH_OLC_WRITERS,
+		BENCH_OLC_READERS, numKeys, numKeys);
+	printf("%-9s %14s %14s %8s %8s \n", "max_keys", "puts/sec", "gets/sec", "wrong", "result");
+	for (size_t m = 0; m < sizeof(maxKeys) / sizeof(maxKeys[0]); m++){
+		olcRun run = {.numKeys = numKeys, .perWriter = numKeys / BENCH_OLC_WRITERS, .stop = false};
+		run.tree = bptree_create(maxKeys[m], NULL, false);
+		bptree_bulk_load(run.tree, keys, values, numKeys, 1.0);
+		olcWorker workers[BENCH_OLC_WRITERS + BENCH_OLC_READERS];
+		double start = nowSeconds();
+		for (int i = 0; i < BENCH_OLC_WRITERS + BENCH_OLC_READERS; i++){
+			workers[i] = (olcWorker){.run = &run, .index = i, .seed = 88172645463325252ULL + i * 7919};
+			pthread_create(&workers[i].thread, NULL, i < BENCH_OLC_WRITERS ? olcWriter : olcReader, &workers[i]);
+		}
+		uint64_t puts = 0;
+		uint64_t gets = 0;
+		for (int i = 0; i < BENCH_OLC_WRITERS; i++){
+			pthread_join(workers[i].thread, NULL);
+			puts += workers[i].ops;
+		}
+		run.stop = true;
+		for (int i = BENCH_OLC_WRITERS; i < BENCH_OLC_WRITERS + BENCH_OLC_READERS; i++){
+			pthread_join(workers[i].thread, NULL);
+			gets += workers[i].ops;
+		}
+		double elapsed = nowSeconds() - start;
+
+		// with every thread done, all keys have to be there with their values
+		int64_t inserted = run.perWriter * BENCH_OLC_WRITERS;
+		for (int64_t i = 0; i < numKeys; i++){
+			run.wrong += !olcFound(run.tree, i * 2);
+		}
+		for (int64_t i = 0; i < inserted; i++){
+			run.wrong += !olcFound(run.tree, i * 2 + 1);
+		}
+		bool ok = run.wrong == 0 && bptree_get_stats(run.tree).count == numKeys + inserted
+			&& bptree_check_invariants(run.tree);
+		failed |= !ok;
+		printf("%-9d %14.0f %14.0f %8" PRIu64 " %8s \n", maxKeys[m], puts / elapsed, gets / elapsed, run.wrong,
+			ok ? "ok" : "FAILED");
+		bptree_free(run.tree);
+	}
+	free(keys);
+	free(values);
+	if (failed){
+		printf("error concurrent gets and puts lost or changed keys exiting..");
+		exit(1);
+	}
+}
+
+static void benchBatch(int64_t numKeys){
+	const int batchSize = 1024; // WAL_BATCH_SIZE, what insert hands over at a time
+	bptree_key_t* keys = malloc(numKeys * sizeof(bptree_key_t));
+	rowLocator* values = malloc(numKeys * sizeof(rowLocator));
+	printf("%-12s %-10s %12s %12s \n", "keys", "api", "ms", "ns/key");
+	const char* orders[] = {"ascending", "random"};
+	for (int order = 0; order < 2; order++){
+		uint64_t state = 88172645463325252ULL;
+		for (int64_t i = 0; i < numKeys; i++){
+			keys[i] = order == 0 ? i : (int64_t)(nextRandom(&state) >> 1);
+			values[i] = (rowLocator){(uint32_t)(i / ROWS_PER_PAGE), (uint32_t)(i % ROWS_PER_PAGE)};
+		}
+		for (int batched = 0; batched < 2; batched++){
+			bptree* tree = bptree_create(BENCH_BPTREE_MAX_KEYS, NULL, false);
+			double start = nowSeconds();
+			for (int64_t i = 0; i < numKeys; i += batchSize){
+				int n = numKeys - i < batchSize ? numKeys - i : batchSize;
+				if (batched){
+					bptree_put_batch(tree, &keys[i], &values[i], n, NULL);
+				}
+				else{
+					for (int j = 0; j < n; j++){
+						bptree_put(tree, &keys[i + j], values[i + j]);
+					}
+				}
+			}
+			double elapsed = nowSeconds() - start;
+			printf("%-12s %-10s %12.0f %12.1f \n", orders[order], batched ? "put_batch" : "put",
+				elapsed * 1e3, elapsed * 1e9 / numKeys);
+			bptree_free(tree);
+		}
+	}
+	free(keys);
+	free(values);
+}
+
+// Every tree is sized with bptree_max_keys_for_size, from two cache lines up to
+// four pages. Keys are inserted in random order, looked up at random, then
+// read back in scans of BENCH_SCAN_KEYS keys from random starting points.
+static void benchNodes(int64_t numKeys){
+	const size_t nodeBytes[] = {128, 256, 512, 1024, 2048, 4096, 8192, 16384};
+	const int lookups = 2000000;
+	const int scans = 20000;
+	bptree_key_t* keys = malloc(numKeys * sizeof(bptree_key_t));
+	uint64_t state = 88172645463325252ULL;
+	for (int64_t i = 0; i < numKeys; i++){
+		keys[i] = (int64_t)(nextRandom(&state) >> 1);
+	}
+	printf("%-8s %8s %8s %12s %12s %14s \n", "bytes", "maxKeys", "height", "ns/put", "ns/get", "scan Mkeys/s");
+	for (size_t s = 0; s < sizeof(nodeBytes) / sizeof(nodeBytes[0]); s++){
+		int maxKeys = bptree_max_keys_for_size(nodeBytes[s]);
+		bptree* tree = bptree_create(maxKeys, NULL, false);
+		double start = nowSeconds();
+		for (int64_t i = 0; i < numKeys; i++){
+			rowLocator loc = {(uint32_t)(i / ROWS_PER_PAGE), (uint32_t)(i % ROWS_PER_PAGE)};
+			bptree_put(tree, &keys[i], loc);
+		}
+		double putNs = (nowSeconds() - start) * 1e9 / numKeys;
+
+		rowLocator loc;
+		int found = 0;
+		start = nowSeconds();
+		for (int i = 0; i < lookups; i++){
+			found += bptree_get(tree, &keys[nextRandom(&state) % numKeys], &loc) == BPTREE_OK;
+		}
+		double getNs = (nowSeconds() - start) * 1e9 / lookups;
+		if (found != lookups){
+			printf("lookups missed \n");
+		}
+
+		int64_t scanned = 0;
+		start = nowSeconds();
+		for (int i = 0; i < scans; i++){
+			bptree_cursor cursor;
+			bptree_cursor_seek(tree, &keys[nextRandom(&state) % numKeys], NULL, &cursor);
+			for (int n = 0; n < BENCH_SCAN_KEYS && bptree_cursor_next(&cursor, NULL, &loc) == BPTREE_OK; n++){
+				scanned++;
+			}
+			bptree_cursor_close(&cursor);
+		}
+		double scanRate = scanned / (nowSeconds() - start) / 1e6;
+		printf("%-8zu %8d %8d %12.1f %12.1f %14.1f \n", nodeBytes[s], maxKeys, tree->height, putNs, getNs, scanRate);
+		bptree_free(tree);
+	}
+	free(keys);
+}
+
+typedef enum {
+	SCAN_NONE,     // writer alone
+	SCAN_MUTEX,    // reader holds the writer's lock for the whole scan
+	SCAN_SNAPSHOT  // reader holds it only to take a snapshot
+} scanMode;
+
+typedef struct snapshotRun {
+	bptree* tree;
+	int64_t numKeys;
+	scanMode mode;
+	pthread_mutex_t lock;
+	volatile bool stop;
+	uint64_t puts;
+	uint64_t scans;
+	uint64_t scanned;
+} snapshotRun;
+
+// random odd keys, so every part of the tree keeps changing under the scans
+static void* snapshotWriter(void* arg){
+	snapshotRun* run = arg;
+	uint64_t state = 88172645463325252ULL;
+	for (int64_t i = 0; !run->stop; i++){
+		bptree_key_t key = (nextRandom(&state) % run->numKeys) * 2 + 1;
+		rowLocator loc = {(uint32_t)(i / ROWS_PER_PAGE), (uint32_t)(i % ROWS_PER_PAGE)};
+		pthread_mutex_lock(&run->lock);
+		bptree_put(run->tree, &key, loc);
+		pthread_mutex_unlock(&run->lock);
+		run->puts++;
+	}
+	return NULL;
+}
+
+// full scans of the tree, like a backup or a long range query would do
+static void* snapshotReader(void* arg){
+	snapshotRun* run = arg;
+	rowLocator loc;
+	while (!run->stop){
+		bptree_cursor cursor;
+		bptree_snapshot* snapshot = NULL;
+		pthread_mutex_lock(&run->lock);
+		if (run->mode == SCAN_SNAPSHOT){
+			snapshot = bptree_snapshot_take(run->tree);
+			pthread_mutex_unlock(&run->lock);
+			bptree_snapshot_cursor_seek(snapshot, NULL, NULL, &cursor);
+		}
+		else{
+			bptree_cursor_seek(run->tree, NULL, NULL, &cursor);
+		}
+		while (bptree_cursor_next(&cursor, NULL, &loc) == BPTREE_OK){
+			run->scanned++;
+		}
+		if (run->mode == SCAN_SNAPSHOT){
+			bptree_snapshot_release(snapshot);
+		}
+		else{
+			pthread_mutex_unlock(&run->lock);
+		}
+		run->scans++;
+	}
+	return NULL;
+}
+
+// One writer keeps inserting while one reader scans the whole tree over and
+// over, either under the writer's lock or from a snapshot taken under it.
+static void benchSnapshot(int64_t numKeys){
+	bptree_key_t* keys = malloc(numKeys * sizeof(bptree_key_t));
+	rowLocator* values = malloc(numKeys * sizeof(rowLocator));
+	for (int64_t i = 0; i < numKeys; i++){
+		keys[i] = i * 2;
+		values[i] = (rowLocator){(uint32_t)(i / ROWS_PER_PAGE), (uint32_t)(i % ROWS_PER_PAGE)};
+	}
+	const char* modes[] = {"none", "mutex", "snapshot"};
+	printf("%d cores, %ld keys to start with \n", csvDefaultThreads(), numKeys);
+	printf("%-10s %14s %12s %14s %10s \n", "reader", "puts/sec", "scans/sec", "scan Mkeys/s", "MB after");
+	for (int mode = SCAN_NONE; mode <= SCAN_SNAPSHOT; mode++){
+		snapshotRun run = {.numKeys = numKeys, .mode = mode, .stop = false};
+		run.tree = bptree_create(BPTREE_AUTO_MAX_KEYS, NULL, false);
+		bptree_bulk_load(run.tree, keys, values, numKeys, 1.0);
+		pthread_mutex_init(&run.lock, NULL);
+		pthread_t writer;
+		pthread_t reader;
+		double start = nowSeconds();
+		pthread_create(&writer, NULL, snapshotWriter, &run);
+		if (mode != SCAN_NONE){
+			pthread_create(&reader, NULL, snapshotReader, &run);
+		}
+		usleep(BENCH_CONCURRENT_SECONDS * 2 * 1e6);
+		run.stop = true;
+		pthread_join(writer, NULL);
+		if (mode != SCAN_NONE){
+			pthread_join(reader, NULL);
+		}
+		double elapsed = nowSeconds() - start;
+		printf("%-10s %14.0f %12.1f %14.1f %10.1f \n", modes[mode], run.puts / elapsed, run.scans / elapsed,
+			run.scanned / elapsed / 1e6, bptree_get_stats(run.tree).bytes / 1e6);
+		pthread_mutex_destroy(&run.lock);
+		bptree_free(run.tree);
+	}
+	free(keys);
+	free(values);
+}
+
+static void timeWhere(mmapReader* reader, secondaryIndexes* secondary, const char* label, rowColumn column,
+	const char* value, bool prefix, int queries){
+	struct Row rows[BENCH_WHERE_ROWS];
+	size_t found = 0;
+	double start = nowSeconds();
+	// the scan stops at the BENCH_WHERE_ROWS'th match, the index counts every match
+	for (int i = 0; i < queries; i++){
+		found = retrieveWhere(reader, secondary, column, value, prefix, rows, BENCH_WHERE_ROWS);
+	}
+	double elapsed = nowSeconds() - start;
+	printf("%-24s %-6s %10zu %14.3f \n", label, secondary ? "index" : "scan", found, elapsed * 1e3 / queries);
+}
+
+static void benchWhere(int64_t numRows){
+	unlink(BENCH_DB);
+	unlink(BENCH_INDEX);
+	bufferPool* pool = bufferPoolCreate(BUFFER_POOL_BYTES);
+	int db = openDataFile(BENCH_DB);
+	pageIndex* index = pageIndexOpen(BENCH_INDEX, pool);
+	buildTable(db, index, numRows);
+	secondaryIndexes* secondary = secondaryIndexesCreate();
+	double start = nowSeconds();
+	secondaryIndexesBuild(secondary, db);
+	printf("built the name and location indexes for %ld rows in %.0fms \n", numRows, (nowSeconds() - start) * 1e3);
+	for (int column = COLUMN_NAME; column <= COLUMN_LOCATION; column++){
+		secondaryIndexStats stats = secondaryIndexGetStats(secondary, column);
+		printf("%-8s index: height %d, %d nodes, %.1fMB \n", column == COLUMN_NAME ? "name" : "location",
+			stats.height, stats.nodes, stats.bytes / 1048576.0);
+	}
+
+	mmapReader* reader = mmapReaderOpen(db, MMAP_RANDOM);
+	char name[NAME_SIZE];
+	snprintf(name, NAME_SIZE, "User%ld", numRows / 2);
+	printf("%-24s %-6s %10s %14s \n", "query", "path", "count", "ms/query");
+	for (int indexed = 0; indexed < 2; indexed++){
+		secondaryIndexes* with = indexed ? secondary : NULL;
+		timeWhere(reader, with, "name = User<n/2>", COLUMN_NAME, name, false, indexed ? 10000 : 3);
+		timeWhere(reader, with, "location = City7", COLUMN_LOCATION, "City7", false, indexed ? 100 : 3);
+		timeWhere(reader, with, "location like City1*", COLUMN_LOCATION, "City1", true, indexed ? 100 : 3);
+	}
+
+	mmapReaderClose(reader);
+	secondaryIndexesFree(secondary);
+	pageIndexClose(index);
+	close(db);
+	bufferPoolFree(pool);
+	unlink(BENCH_DB);
+	unlink(BENCH_INDEX);
+}
+
+static void countRow(const struct Row* row, void* arg){
+	*(int64_t*)arg += row->id;
+}
+
+static void benchRange(int64_t numRows){
+	unlink(BENCH_DB);
+	unlink(BENCH_INDEX);
+	bufferPool* pool = bufferPoolCreate(BUFFER_POOL_BYTES);
+	int db = openDataFile(BENCH_DB);
+	pageIndex* index = pageIndexOpen(BENCH_INDEX, pool);
+	buildTable(db, index, numRows);
+	mmapReader* reader = mmapReaderOpen(db, MMAP_RANDOM);
+
+	printf("%12s %-10s %14s %10s %10s \n", "rows", "path", "rows/sec", "pages", "reads");
+	for (int64_t width = 100; width <= numRows; width *= 100){
+		int64_t low = numRows / 2 - width / 2 + 1;
+		int64_t high = low + width - 1;
+		struct Row row;
+		int64_t idSum = 0;
+		double start = nowSeconds();
+		for (int64_t id = low; id <= high; id++){
+			if (retrieve(reader, index, id, &row)){
+				idSum += row.id;
+			}
+		}
+		double elapsed = nowSeconds() - start;
+		printf("%12ld %-10s %14.0f %10s %10s \n", width, "retrieve", width / elapsed, "-", "-");
+
+		int64_t rangeSum = 0;
+		start = nowSeconds();
+		rangeStats stats = retrieveRange(db, index, low, high, countRow, &rangeSum);
+		elapsed = nowSeconds() - start;
+		printf("%12ld %-10s %14.0f %10u %10u \n", width, "range", stats.rows / elapsed, stats.pages, stats.reads);
+		if (rangeSum != idSum || (int64_t)stats.rows != width){
+			printf("range read returned %zu rows, expected %ld \n", stats.rows, width);
+		}
+	}
+
+	mmapReaderClose(reader);
+	pageIndexClose(index);
+	close(db);
+	bufferPoolFree(pool);
+	unlink(BENCH_DB);
+	unlink(BENCH_INDEX);
+}
+
+typedef enum {
+	PAX_SCAN_COUNT_LOCATION, // location = City7, one column through pageColumnAt
+	PAX_SCAN_SUM_IDS,        // sum of ids, one column through pageColumnAt
+	PAX_SCAN_MINIPAGE,       // location = City7 straight down the minipage, PAX only
+	PAX_SCAN_ROWS            // every row copied out whole
+} paxScan;
+
+static int64_t runPaxScan(mmapReader* reader, paxScan scan){
+	int64_t result = 0;
+	struct Row row;
+	uint32_t numPages = mmapReaderPages(reader);
+	for (uint32_t page_id = 0; page_id < numPages; page_id++){
+		const char* page = mmapReaderPage(reader, page_id);
+		uint16_t numRows = pageNumSlots(page);
+		if (scan == PAX_SCAN_MINIPAGE){
+			const char* locations = pageColumn(page, COLUMN_LOCATION);
+			for (uint16_t i = 0; i < numRows; i++){
+				result += strncmp(locations + i * LOCATION_SIZE, "City7", LOCATION_SIZE) == 0;
+			}
+			continue;
+		}
+		for (uint16_t i = 0; i < numRows; i++){
+			uint16_t offset = pageRowOffset(page, i);
+			if (scan == PAX_SCAN_COUNT_LOCATION){
+				result += strncmp(pageColumnAt(page, offset, COLUMN_LOCATION), "City7", LOCATION_SIZE) == 0;
+			}
+			else if (scan == PAX_SCAN_SUM_IDS){
+				int64_t id;
+				memcpy(&id, pageColumnAt(page, offset, COLUMN_ID), sizeof(int64_t));
+				result += id;
+			}
+			else{
+				pageReadRow(page, offset, &row);
+				result += row.id;
+			}
+		}
+	}
+	return result;
+}
+
+static void benchPax(int64_t numRows){
+	const char* scanNames[] = {"location = City7", "sum(id)", "minipage City7", "whole rows"};
+	printf("%-8s %-18s %12s %14s %10s \n", "pages", "scan", "result", "Mrows/sec", "file MB");
+	for (uint16_t format = PAGE_FORMAT_SLOTTED; format <= PAGE_FORMAT_PAX; format++){
+		unlink(BENCH_DB);
+		unlink(BENCH_INDEX);
+		bufferPool* pool = bufferPoolCreate(BUFFER_POOL_BYTES);
+		int db = openDataFile(BENCH_DB);
+		pageIndex* index = pageIndexOpen(BENCH_INDEX, pool);
+		buildTableFormat(db, index, numRows, format);
+		mmapReader* reader = mmapReaderOpen(db, MMAP_SEQUENTIAL);
+		double fileMB = mmapReaderPages(reader) * (double)PAGE_SIZE / 1048576.0;
+		// one pass to fault the file in, the timed passes are memory resident
+		runPaxScan(reader, PAX_SCAN_ROWS);
+		for (paxScan scan = PAX_SCAN_COUNT_LOCATION; scan <= PAX_SCAN_ROWS; scan++){
+			if (scan == PAX_SCAN_MINIPAGE && format != PAGE_FORMAT_PAX){
+				continue;
+			}
+			double best = 0;
+			int64_t result = 0;
+			for (int pass = 0; pass < 5; pass++){
+				double start = nowSeconds();
+				result = runPaxScan(reader, scan);
+				double elapsed = nowSeconds() - start;
+				if (pass == 0 || elapsed < best){
+					best = elapsed;
+				}
+			}
+			printf("%-8s %-18s %12ld %14.1f %10.1f \n", format == PAGE_FORMAT_PAX ? "pax" : "slotted",
+				scanNames[scan], result, numRows / best / 1e6, fileMB);
+		}
+		mmapReaderClose(reader);
+		pageIndexClose(index);
+		close(db);
+		bufferPoolFree(pool);
+	}
+	unlink(BENCH_DB);
+	unlink(BENCH_INDEX);
+}
+
+// the filter the way scans were written before scan.c, one row and one
+// strncmp or id compare at a time
+static size_t rowAtATime(mmapReader* reader, const scanPredicate* predicates, int numPredicates){
+	size_t found = 0;
+	uint32_t numPages = mmapReaderPages(reader);
+	for (uint32_t page_id = 0; page_id < numPages; page_id++){
+		const char* page = mmapReaderPage(reader, page_id);
+		for (uint16_t i = 0; i < pageNumSlots(page); i++){
+			uint16_t offset = pageRowOffset(page, i);
+			bool pass = true;
+			for (int p = 0; p < numPredicates && pass; p++){
+				const scanPredicate* predicate = &predicates[p];
+				if (predicate->op == SCAN_ID_RANGE){
+					int64_t id;
+					memcpy(&id, pageColumnAt(page, offset, COLUMN_ID), sizeof(int64_t));
+					pass = id >= predicate->low && id <= predicate->high;
+				}
+				else{
+					size_t len = predicate->op == SCAN_PREFIX ? strlen(predicate->value) : NAME_SIZE;
+					pass = strncmp(pageColumnAt(page, offset, predicate->column), predicate->value, len) == 0;
+				}
+			}
+			found += pass;
+		}
+	}
+	return found;
+}
+
+static bool countSelected(const scanBatch* batch, const uint16_t* selected, uint32_t numSelected, void* arg){
+	(void)batch;
+	(void)selected;
+	*(size_t*)arg += numSelected;
+	return true;
+}
+
+static void benchScan(int64_t numRows){
+	const char* queryNames[] = {"location = City7", "name like User1*", "id in middle half", "City7 and middle half"};
+	scanPredicate queries[][2] = {
+		{{SCAN_EQUALS, COLUMN_LOCATION, "City7", 0, 0}},
+		{{SCAN_PREFIX, COLUMN_NAME, "User1", 0, 0}},
+		{{SCAN_ID_RANGE, COLUMN_ID, NULL, numRows / 4, numRows / 4 * 3}},
+		{{SCAN_ID_RANGE, COLUMN_ID, NULL, numRows / 4, numRows / 4 * 3}, {SCAN_EQUALS, COLUMN_LOCATION, "City7", 0, 0}},
+	};
+	int numPredicates[] = {1, 1, 1, 2};
+	const char* paths[] = {"row", "scalar", "simd"};
+	printf("%-8s %-22s %-7s %10s %12s %8s \n", "pages", "query", "path", "matches", "Mrows/sec", "GB/s");
+	for (uint16_t format = PAGE_FORMAT_SLOTTED; format <= PAGE_FORMAT_PAX; format++){
+		unlink(BENCH_DB);
+		unlink(BENCH_INDEX);
+		bufferPool* pool = bufferPoolCreate(BUFFER_POOL_BYTES);
+		int db = openDataFile(BENCH_DB);
+		pageIndex* index = pageIndexOpen(BENCH_INDEX, pool);
+		buildTableFormat(db, index, numRows, format);
+		mmapReader* reader = mmapReaderOpen(db, MMAP_SEQUENTIAL);
+		double fileBytes = mmapReaderPages(reader) * (double)PAGE_SIZE;
+		// one pass to fault the file in, the timed passes are memory resident
+		rowAtATime(reader, NULL, 0);
+		for (int query = 0; query < 4; query++){
+			for (int path = 0; path < 3; path++){
+				scanUseSimd(path == 2);
+				double best = 0;
+				size_t found = 0;
+				for (int pass = 0; pass < 5; pass++){
+					found = 0;
+					double start = nowSeconds();
+					if (path == 0){
+						found = rowAtATime(reader, queries[query], numPredicates[query]);
+					}
+					else{
+						scanFilter(reader, queries[query], numPredicates[query], countSelected, &found);
+					}
+					double elapsed = nowSeconds() - start;
+					if (pass == 0 || elapsed < best){
+						best = elapsed;
+					}
+				}
+				printf("%-8s %-22s %-7s %10zu %12.1f %8.2f \n", format == PAGE_FORMAT_PAX ? "pax" : "slotted",
+					queryNames[query], paths[path], found, numRows / best / 1e6, fileBytes / best / 1e9);
+			}
+		}
+		scanUseSimd(true);
+		mmapReaderClose(reader);
+		pageIndexClose(index);
+		close(db);
+		bufferPoolFree(pool);
+	}
+	unlink(BENCH_DB);
+	unlink(BENCH_INDEX);
+}
+
+static void benchGroup(int64_t numRows){
+	unlink(BENCH_DB);
+	unlink(BENCH_INDEX);
+	bufferPool* pool = bufferPoolCreate(BUFFER_POOL_BYTES);
+	int db = openDataFile(BENCH_DB);
+	pageIndex* index = pageIndexOpen(BENCH_INDEX, pool);
+	buildTable(db, index, numRows);
+	mmapReader* reader = mmapReaderOpen(db, MMAP_SEQUENTIAL);
+	// one pass to fault the file in, the timed passes are memory resident
+	rowAtATime(reader, NULL, 0);
+	scanPredicate middleHalf = {SCAN_ID_RANGE, COLUMN_ID, NULL, numRows / 4, numRows / 4 * 3};
+	const char* queryNames[] = {"by location", "by location, middle half", "by name"};
+	rowColumn queryColumns[] = {COLUMN_LOCATION, COLUMN_LOCATION, COLUMN_NAME};
+	printf("%-26s %8s %10s %10s %12s \n", "group", "threads", "rows", "groups", "Mrows/sec");
+	for (int query = 0; query < 3; query++){
+		for (int threads = 1; threads <= AGGREGATE_MAX_THREADS; threads *= 2){
+			double best = 0;
+			aggregateResult result = {0};
+			for (int pass = 0; pass < 3; pass++){
+				aggregateResultFree(&result);
+				double start = nowSeconds();
+				result = aggregateBy(reader, queryColumns[query], query == 1 ? &middleHalf : NULL, query == 1, threads);
+				double elapsed = nowSeconds() - start;
+				if (pass == 0 || elapsed < best){
+					best = elapsed;
+				}
+			}
+			int64_t count = 0;
+			for (size_t i = 0; i < result.numGroups; i++){
+				count += result.groups[i].count;
+			}
+			if ((size_t)count != result.rows){
+				printf("group counts add up to %ld, expected %zu \n", count, result.rows);
+			}
+			printf("%-26s %8d %10zu %10zu %12.1f \n", queryNames[query], result.threads, result.rows,
+				result.numGroups, numRows / best / 1e6);
+			aggregateResultFree(&result);
+		}
+	}
+	mmapReaderClose(reader);
+	pageIndexClose(index);
+	close(db);
+	bufferPoolFree(pool);
+	unlink(BENCH_DB);
+	unlink(BENCH_INDEX);
+}
+
+int main(int argc, char * argv[]){
+	if (argc < 2){
+		printf("program Usage : ./bench lookup [maxRows] | ./bench parse file.csv | ./bench bptree [numKeys] | ./bench compare [numKeys] | ./bench search | ./bench concurrent [keys] | ./bench olc [numKeys] | ./bench batch [numKeys] | ./bench where [numRows] | ./bench range [numRows] | ./bench pax [numRows] | ./bench scan [numRows] | ./bench group [numRows] | ./bench nodes [numKeys] | ./bench snapshot [numKeys] \n");
+		exit(1);
+	}
+	if (strcmp(argv[1], "lookup") == 0){
+		benchLookup(argc > 2 ? strtol(argv[2], NULL, 10) : 1000000);
+	}
+	else if (strcmp(argv[1], "bptree") == 0){
+		benchBptree(argc > 2 ? strtol(argv[2], NULL, 10) : 50000000);
+	}
+	else if (strcmp(argv[1], "compare") == 0){
+		benchCompare(argc > 2 ? strtol(argv[2], NULL, 10) : 1000000);
+	}
+	else if (strcmp(argv[1], "search") == 0){
+		benchSearch();
+	}
+	else if (strcmp(argv[1], "concurrent") == 0){
+		benchConcurrent(argc > 2 ? strtol(argv[2], NULL, 10) : 1000000);
+	}
+	else if (strcmp(argv[1], "olc") == 0){
+		benchOlc(argc > 2 ? strtol(argv[2], NULL, 10) : 200000);
+	}
+	else if (strcmp(argv[1], "batch") == 0){
+		benchBatch(argc > 2 ? strtol(argv[2], NULL, 10) : 10000000);
+	}
+	else if (strcmp(argv[1], "where") == 0){
+		benchWhere(argc > 2 ? strtol(argv[2], NULL, 10) : 1000000);
+	}
+	else if (strcmp(argv[1], "range") == 0){
+		benchRange(argc > 2 ? strtol(argv[2], NULL, 10) : 1000000);
+	}
+	else if (strcmp(argv[1], "pax") == 0){
+		benchPax(argc > 2 ? strtol(argv[2], NULL, 10) : 1000000);
+	}
+	else if (strcmp(argv[1], "scan") == 0){
+		benchScan(argc > 2 ? strtol(argv[2], NULL, 10) : 1000000);
+	}
+	else if (strcmp(argv[1], "group") == 0){
+		benchGroup(argc > 2 ? strtol(argv[2], NULL, 10) : 1000000);
+	}
+	else if (strcmp(argv[1], "nodes") == 0){
+		benchNodes(argc > 2 ? strtol(argv[2], NULL, 10) : 1000000);
+	}
+	else if (strcmp(argv[1], "snapshot") == 0){
+		benchSnapshot(argc > 2 ? strtol(argv[2], NULL, 10) : 1000000);
+	}
+	else if (strcmp(argv[1], "parse") == 0 && argc > 2){
+		benchParse(argv[2]);
+	}
+	else{
+		printf("unknown benchmark %s \n", argv[1]);
+		exit(1);
+	}
+	return 0;
+}
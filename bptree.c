@@ -1,2 +1,3 @@
+#include "db.h" // BPTREE_VALUE_TYPE
 #define BPTREE_IMPLEMENTATION
 #include "bptree.h"
@@ -10,7 +10,7 @@
  * ===============================================================================
  * Key/value types and linkage can be customized via macros defined BEFORE
  * including the header (e.g., BPTREE_NUMERIC_TYPE, BPTREE_VALUE_TYPE,
- * BPTREE_KEY_TYPE_STRING/BPTREE_KEY_SIZE, BPTREE_STATIC).
+ * BPTREE_KEY_TYPE_STRING/BPTREE_KEY_SIZE, BPTREE_STATIC, BPTREE_NO_COUNTERS).
  * See implementation details for specific macro effects.
  *
  * ===============================================================================
@@ -34,14 +34,26 @@
  *   - Functions return `bptree_status` codes; check for `BPTREE_OK` for success.
  *
  * - Memory Management:
- *   - The tree manages memory for its internal nodes.
+ *   - The tree manages memory for its internal nodes. Nodes come from per-tree slabs
+ *     (see `BPTREE_SLAB_SIZE`); removed nodes are recycled, and the slabs are only
+ *     returned to the system by `bptree_free()`.
  *   - The tree DOES NOT manage memory for stored values (type `BPTREE_VALUE_TYPE`).
  *     If storing pointers, the caller must allocate/free the pointed-to data.
  *   - Call `bptree_free()` to release tree structure memory (does not free values).
+ *   - String keys are stored prefix-compressed (see `bptree_packed_keys`), so a node of
+ *     short keys with a common prefix takes far less than `BPTREE_KEY_SIZE` bytes per key.
+ *   - While a snapshot is held, writes copy the nodes they change instead of changing them,
+ *     and the replaced nodes are only recycled once every snapshot that can see them is
+ *     released (see `bptree_snapshot_take()`). Release every snapshot before `bptree_free()`.
  *
  * - Thread Safety:
  *   - This implementation is NOT thread-safe. Caller must provide external
  *     synchronization (e.g., mutexes) for concurrent access.
+ *   - The exception is `bptree_get_concurrent()` and `bptree_put_concurrent()`, which any
+ *     number of threads may call at once on the same tree (optimistic lock coupling).
+ *     Other calls still need the tree to themselves.
+ *   - A snapshot (`bptree_snapshot_take()`) is a frozen version of the tree. Once taken, it
+ *     can be read and released from any thread while the tree's owner keeps writing.
  *
  * @version 0.4.3
  * @author
@@ -62,13 +74,19 @@ extern "C" {
 #define BPTREE_API __attribute__((visibility("default")))
 #endif
 #else
+#if defined(__GNUC__) || defined(__clang__)
+/* A program that compiles its own static copy rarely calls every function. */
+#define BPTREE_API static __attribute__((unused))
+#else
 #define BPTREE_API static
 #endif
+#endif
 
 #include <assert.h>
 #include <stdalign.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -95,6 +113,34 @@ typedef struct {
 typedef BPTREE_NUMERIC_TYPE bptree_key_t;
 #endif
 
+#ifndef BPTREE_SLAB_SIZE
+/** @brief Bytes requested from the system per node slab. */
+#define BPTREE_SLAB_SIZE (1 << 20)
+#endif
+
+#ifndef BPTREE_NODE_BYTES
+/** @brief Node size bptree_create() fills when given BPTREE_AUTO_MAX_KEYS; one 4KB page. */
+#define BPTREE_NODE_BYTES 4096
+#endif
+
+#ifndef BPTREE_CACHE_LINE
+/** @brief Nodes this size or larger start on a multiple of it, so none straddles a spare line. */
+#define BPTREE_CACHE_LINE 64
+#endif
+
+/** @brief max_keys for bptree_create() that sizes nodes to BPTREE_NODE_BYTES. */
+#define BPTREE_AUTO_MAX_KEYS 0
+
+#ifdef BPTREE_KEY_TYPE_STRING
+#ifndef BPTREE_PACK_GRANULE
+/** @brief Packed key widths are rounded up to a multiple of this, one block pool per multiple. */
+#define BPTREE_PACK_GRANULE 8
+#endif
+/** @brief Number of packed key block sizes, from width 0 up to BPTREE_KEY_SIZE. */
+#define BPTREE_PACK_CLASSES \
+    ((int)((BPTREE_KEY_SIZE + BPTREE_PACK_GRANULE - 1) / BPTREE_PACK_GRANULE + 1))
+#endif
+
 #ifndef BPTREE_VALUE_TYPE
 #define BPTREE_VALUE_TYPE void*
 #endif
@@ -117,6 +163,26 @@ typedef enum {
     BPTREE_INTERNAL_ERROR      /**< Internal consistency error */
 } bptree_status;
 
+#ifdef BPTREE_KEY_TYPE_STRING
+/**
+ * @brief Prefix-compressed keys of one node.
+ *
+ * The bytes every key of the node starts with are stored once. Each key then keeps only its
+ * next width bytes, since past prefix_len + width every key of the node is zero. Slots are
+ * all width bytes, so keys are still found by index. Blocks come from one pool per width
+ * (rounded up to BPTREE_PACK_GRANULE), and separators are cut down to the shortest key that
+ * still splits their children, so they pack into narrow slots too.
+ * This structure is used internally by the tree; users should not access its members directly.
+ */
+typedef struct bptree_packed_keys {
+    uint16_t prefix_len;          /**< Bytes every key of the node starts with */
+    uint16_t width;               /**< Bytes kept per key after the prefix */
+    uint16_t size_class;          /**< Pool the block belongs to, widths up to this many granules */
+    char prefix[BPTREE_KEY_SIZE]; /**< The shared prefix */
+    char slots[];                 /**< max_keys + 1 slots of width bytes */
+} bptree_packed_keys;
+#endif
+
 /**
  * @brief Internal B+ tree node.
  *
@@ -127,15 +193,84 @@ struct bptree_node {
     bool is_leaf;      /**< True if node is a leaf node */
     int num_keys;      /**< Number of keys stored in the node */
     bptree_node* next; /**< Pointer to the next leaf (used in range queries) */
+    uint64_t version;  /**< Latch for the concurrent API: odd while write-locked, bumped on unlock */
+    uint64_t gen;      /**< Tree generation the node was allocated in (see bptree_snapshot) */
+#ifdef BPTREE_KEY_TYPE_STRING
+    bptree_packed_keys* packed; /**< The node's keys, NULL while it has none */
+#endif
     char data[]; /**< Flexible array member that holds keys and either values or child pointers */
 };
 
+/**
+ * @brief Slab allocator for nodes of one size.
+ *
+ * Nodes are carved out of large slabs and recycled through a free list, so a split costs a
+ * pointer bump instead of a call into the system allocator.
+ * This structure is used internally by the tree; users should not access its members directly.
+ */
+typedef struct bptree_node_pool {
+    size_t node_size;       /**< Bytes per node, a multiple of align */
+    size_t align;           /**< Alignment of every node */
+    char* bump;             /**< Next never-used node in the newest slab */
+    char* bump_end;         /**< End of the newest slab */
+    bptree_node* free_list; /**< Released nodes, chained through their next pointer */
+    void* slabs;            /**< Newest slab; each slab starts with a pointer to the previous one */
+    size_t reserved;        /**< Bytes in all slabs */
+} bptree_node_pool;
+
+typedef struct bptree bptree;
+
+/**
+ * @brief A read-only version of a tree, frozen at bptree_snapshot_take().
+ *
+ * Nothing reachable from the snapshot's root changes while it is held: writers copy a node
+ * before changing it if its generation is at or below that of a live snapshot. Snapshots
+ * never follow leaf `next` pointers, which stay owned by the live tree.
+ */
+typedef struct bptree_snapshot bptree_snapshot;
+struct bptree_snapshot {
+    bptree* tree;           /**< Tree the snapshot was taken of */
+    bptree_node* root;      /**< Root as of the snapshot */
+    int count;              /**< Number of key/value pairs in the snapshot */
+    int height;             /**< Height of the snapshot */
+    uint64_t gen;           /**< Generation of the newest nodes the snapshot can see */
+    bptree_snapshot* older; /**< Next older live snapshot, NULL for the oldest */
+    bptree_snapshot* newer; /**< Next newer live snapshot, NULL for the newest */
+};
+
+/**
+ * @brief A node replaced by a copy while snapshots could still read it.
+ *
+ * This structure is used internally by the tree; users should not access its members directly.
+ */
+typedef struct bptree_retired_node {
+    bptree_node* node; /**< The replaced node */
+    uint64_t gen;      /**< Generation it was replaced in; snapshots older than this see it */
+} bptree_retired_node;
+
+/**
+ * @brief Running totals of the work a tree has done.
+ *
+ * Kept up as operations run: each lookup, insert, remove or seek adds its search work once,
+ * and splits, merges and borrows are counted where they happen. Updates are relaxed atomic
+ * adds, so readers on other threads can count too. Define BPTREE_NO_COUNTERS to compile
+ * them out. This structure is used internally by the tree; read it with bptree_get_stats().
+ */
+typedef struct bptree_counters {
+    uint64_t descents;        /**< Root-to-leaf searches */
+    uint64_t nodes_visited;   /**< Nodes searched by those descents */
+    uint64_t est_comparisons; /**< Key comparisons estimated from node sizes, not counted */
+    uint64_t splits;          /**< Nodes split by inserts */
+    uint64_t merges;          /**< Nodes merged into a sibling by removes */
+    uint64_t borrows;         /**< Keys moved over from a sibling by removes */
+} bptree_counters;
+
 /**
  * @brief B+ tree structure.
  *
  * Represents the B+ tree and holds its configuration along with the root pointer.
  */
-typedef struct bptree {
+struct bptree {
     int count;             /**< Total number of key/value pairs in the tree */
     int height;            /**< Current height of the tree */
     bool enable_debug;     /**< If true, debug messages will be printed */
@@ -144,15 +279,61 @@ typedef struct bptree {
     int min_internal_keys; /**< Minimum keys needed in a non-root internal node */
     int (*compare)(const bptree_key_t*, const bptree_key_t*); /**< Function to compare two keys */
     bptree_node* root; /**< Pointer to the root node of the tree */
-} bptree;
+    bptree_node_pool leaf_pool;     /**< Storage for leaf nodes */
+    bptree_node_pool internal_pool; /**< Storage for internal nodes */
+#ifdef BPTREE_KEY_TYPE_STRING
+    bptree_node_pool key_pools[BPTREE_PACK_CLASSES]; /**< Storage for packed keys, by width */
+#endif
+    bool pool_latch;                /**< Spin latch around the pools for concurrent inserts */
+    uint64_t gen;                   /**< Generation stamped on new nodes, bumped per snapshot */
+    uint64_t snapshot_gen;          /**< Newest live snapshot's generation, 0 if none */
+    bptree_snapshot* oldest_snapshot; /**< Live snapshots, oldest first, under snapshot_latch */
+    bptree_snapshot* newest_snapshot; /**< Newest live snapshot, under snapshot_latch */
+    bool snapshot_latch;            /**< Spin latch around the snapshot list */
+    bool snapshot_released;         /**< Set when a snapshot goes, so the writer reclaims */
+    bptree_retired_node* retired;   /**< Replaced nodes, in the order they were replaced */
+    int retired_count;              /**< Entries in retired */
+    int retired_capacity;           /**< Room in retired */
+    int leaf_nodes;                 /**< Leaf nodes allocated, kept up by alloc and release */
+    int internal_nodes;             /**< Internal nodes allocated */
+    bptree_counters counters;       /**< Operation counts, last so readers' adds stay off the
+                                         lines they read */
+};
+
+/**
+ * @brief Position in a range scan.
+ *
+ * Filled by bptree_cursor_seek() and advanced by bptree_cursor_next(). A cursor is a plain
+ * value the caller owns (usually on the stack); it holds no allocations. It is only valid
+ * while the tree is not modified, or for bptree_snapshot_cursor_seek(), while the snapshot
+ * is held.
+ */
+typedef struct bptree_cursor {
+    const bptree* tree;       /**< Tree being scanned */
+    const bptree_node* root;  /**< Snapshot root to find each next leaf from, NULL for the tree */
+    const bptree_node* leaf;  /**< Leaf holding the next pair, NULL once the scan is done */
+    int pos;                  /**< Index of the next pair in leaf */
+    bool has_end;             /**< True if the scan stops after end */
+    bptree_key_t end;         /**< Last key to return (inclusive) when has_end is set */
+} bptree_cursor;
 
 /**
  * @brief B+ tree statistics.
+ *
+ * Node counts include nodes only live snapshots still see. The operation counts are totals
+ * since bptree_create(); divide by descents for per-search averages.
  */
 typedef struct bptree_stats {
-    int count;      /**< Total number of key/value pairs */
-    int height;     /**< Tree height */
-    int node_count; /**< Total number of nodes in the tree */
+    int count;             /**< Total number of key/value pairs */
+    int height;            /**< Tree height */
+    int node_count;        /**< Total number of nodes in the tree */
+    size_t bytes;          /**< Bytes of node (and packed key) storage the tree holds */
+    int leaf_count;        /**< Leaf nodes */
+    int internal_count;    /**< Internal nodes */
+    size_t leaf_bytes;     /**< Bytes taken by leaf nodes (packed keys not included) */
+    size_t internal_bytes; /**< Bytes taken by internal nodes (packed keys not included) */
+    double fill_factor;    /**< Average fraction of leaf slots in use, 0 to 1 */
+    bptree_counters ops;   /**< Operation counts, all 0 with BPTREE_NO_COUNTERS */
 } bptree_stats;
 
 /*------------------------------------------------------------------------------
@@ -165,7 +346,8 @@ typedef struct bptree_stats {
  * Allocates and initializes a new B+ tree with the specified parameters.
  *
  * @param max_keys Maximum number of keys that each node can contain.
- *                 Must be at least 3.
+ *                 Must be at least 3, or BPTREE_AUTO_MAX_KEYS for as many as fit in
+ *                 BPTREE_NODE_BYTES (see bptree_max_keys_for_size()).
  * @param compare Function pointer for comparing two keys. If NULL, the default comparison is used.
  * @param enable_debug Set to true to enable debug output.
  * @return Pointer to the newly created B+ tree, or NULL if allocation fails.
@@ -174,6 +356,18 @@ BPTREE_API bptree* bptree_create(int max_keys,
                                  int (*compare)(const bptree_key_t*, const bptree_key_t*),
                                  bool enable_debug);
 
+/**
+ * @brief Largest max_keys whose leaf and internal nodes both fit in a byte size.
+ *
+ * Uses the same size and alignment math as the node allocator, so a tree created with the
+ * result has nodes of at most @p node_bytes each (a cache line multiple, or a page). String
+ * keys are counted at their full BPTREE_KEY_SIZE, so their packed nodes come out smaller.
+ *
+ * @param node_bytes Target node size in bytes.
+ * @return The key count, never below the minimum of 3.
+ */
+BPTREE_API int bptree_max_keys_for_size(size_t node_bytes);
+
 /**
  * @brief Frees a B+ tree.
  *
@@ -221,6 +415,47 @@ BPTREE_API bptree_status bptree_get(const bptree* tree, const bptree_key_t* key,
  */
 BPTREE_API bptree_status bptree_remove(bptree* tree, const bptree_key_t* key);
 
+/**
+ * @brief Inserts a batch of key-value pairs.
+ *
+ * Sorts the batch if it is not already in key order, then descends once per leaf and
+ * inserts the whole run of keys that lands in that leaf. A leaf only splits when it
+ * overflows. Keys above every key in the tree go straight to the right-most leaf without
+ * a search, which makes appending ascending ids cheap. Keys already in the tree, or
+ * repeated in the batch, are skipped.
+ *
+ * @param tree Pointer to the B+ tree.
+ * @param keys Array of @p n keys, in any order.
+ * @param values Array of @p n values matching @p keys.
+ * @param n Number of pairs.
+ * @param n_inserted Where to store how many pairs were inserted, may be NULL.
+ * @return BPTREE_OK if successful (duplicates are not an error), or an error code.
+ */
+BPTREE_API bptree_status bptree_put_batch(bptree* tree, const bptree_key_t* keys,
+                                          const bptree_value_t* values, int n, int* n_inserted);
+
+/**
+ * @brief Builds the tree bottom-up from sorted key/value pairs.
+ *
+ * Fills leaves left to right, links them through `next`, then builds each internal
+ * level on top of the one below in a single pass. This is linear in @p n, unlike
+ * calling bptree_put() once per pair. The tree must be empty and the keys must be
+ * strictly increasing.
+ *
+ * @param tree Pointer to an empty B+ tree.
+ * @param keys Array of @p n keys in strictly increasing order.
+ * @param values Array of @p n values matching @p keys.
+ * @param n Number of pairs.
+ * @param fill_factor Fraction of each node to fill, in (0, 1]. Nodes never drop below
+ *                    the tree's minimum occupancy, whatever the fill factor.
+ * @return BPTREE_OK on success, BPTREE_INVALID_ARGUMENT if the tree is not empty, has
+ *         snapshots or the keys are not sorted, BPTREE_ALLOCATION_FAILURE on allocation failure
+ *         (the tree is left empty).
+ */
+BPTREE_API bptree_status bptree_bulk_load(bptree* tree, const bptree_key_t* keys,
+                                          const bptree_value_t* values, int n,
+                                          double fill_factor);
+
 /**
  * @brief Retrieves a range of values.
  *
@@ -238,6 +473,41 @@ BPTREE_API bptree_status bptree_get_range(const bptree* tree, const bptree_key_t
                                           const bptree_key_t* end, bptree_value_t** out_values,
                                           int* n_results);
 
+/**
+ * @brief Positions a cursor at the start of a range.
+ *
+ * Descends to the first key >= start. Pairs are then read with bptree_cursor_next() straight
+ * from the leaf chain, in key order, without allocating.
+ *
+ * @param tree Pointer to the B+ tree.
+ * @param start First key of the range, or NULL to start at the smallest key.
+ * @param end Last key of the range (inclusive), or NULL to scan to the largest key.
+ * @param cursor Cursor to initialize.
+ * @return BPTREE_OK if successful, BPTREE_INVALID_ARGUMENT if start > end.
+ */
+BPTREE_API bptree_status bptree_cursor_seek(const bptree* tree, const bptree_key_t* start,
+                                            const bptree_key_t* end, bptree_cursor* cursor);
+
+/**
+ * @brief Reads the next pair of a range scan.
+ *
+ * @param cursor Cursor positioned by bptree_cursor_seek().
+ * @param out_key Where to store the key, may be NULL.
+ * @param out_value Where to store the value, may be NULL.
+ * @return BPTREE_OK if a pair was read, BPTREE_KEY_NOT_FOUND once the range is exhausted.
+ */
+BPTREE_API bptree_status bptree_cursor_next(bptree_cursor* cursor, bptree_key_t* out_key,
+                                            bptree_value_t* out_value);
+
+/**
+ * @brief Ends a range scan.
+ *
+ * Nothing is freed; the cursor just reports the end of the range from then on.
+ *
+ * @param cursor Cursor to close.
+ */
+BPTREE_API void bptree_cursor_close(bptree_cursor* cursor);
+
 /**
  * @brief Frees a range query result.
  *
@@ -250,7 +520,8 @@ BPTREE_API void bptree_free_range_results(bptree_value_t* results);
 /**
  * @brief Gets statistics about the tree.
  *
- * Returns a structure containing element count, tree height, and node count.
+ * Returns the element count, height, node counts, memory use, leaf fill and operation
+ * counts. Everything is kept up incrementally, so this is O(1) and can be called often.
  *
  * @param tree Pointer to the B+ tree.
  * @return A bptree_stats structure.
@@ -278,8 +549,113 @@ BPTREE_API bool bptree_check_invariants(const bptree* tree);
  */
 BPTREE_API bool bptree_contains(const bptree* tree, const bptree_key_t* key);
 
+/**
+ * @brief Looks up a key while other threads may be inserting.
+ *
+ * Takes no locks: each node's version is read before and checked after it is searched, and
+ * the lookup restarts from the root if a writer changed a node on the way.
+ *
+ * @param tree Pointer to the B+ tree.
+ * @param key Pointer to the key to search for.
+ * @param out_value Pointer to store the found value.
+ * @return BPTREE_OK if found, BPTREE_KEY_NOT_FOUND otherwise.
+ */
+BPTREE_API bptree_status bptree_get_concurrent(const bptree* tree, const bptree_key_t* key,
+                                               bptree_value_t* out_value);
+
+/**
+ * @brief Inserts a key-value pair while other threads may be reading or inserting.
+ *
+ * Descends like bptree_get_concurrent(), then write-latches only the nodes the insert
+ * changes: the leaf, plus the full ancestors that will split and the first one that won't.
+ * Nodes are never removed from under a reader, so bptree_remove() must not run concurrently.
+ * Nodes are changed in place, so the tree must not have live snapshots.
+ *
+ * @param tree Pointer to the B+ tree.
+ * @param key Pointer to the key to insert.
+ * @param value Value to insert.
+ * @return BPTREE_OK if inserted, BPTREE_DUPLICATE_KEY if the key exists,
+ *         BPTREE_INVALID_ARGUMENT if the tree has snapshots, or an error code.
+ */
+BPTREE_API bptree_status bptree_put_concurrent(bptree* tree, const bptree_key_t* key,
+                                               bptree_value_t value);
+
+/**
+ * @brief Takes a consistent, read-only snapshot of the tree.
+ *
+ * O(1): the snapshot shares every node with the tree. From then on bptree_put(),
+ * bptree_put_batch() and bptree_remove() copy the root-to-leaf path they change (plus any
+ * sibling a rebalance touches) the first time they change it, so the snapshot keeps seeing
+ * the tree as it was. Like other writes, this needs the tree to itself, but it only holds
+ * it for the call; reading and releasing the snapshot can then happen on any thread while
+ * the writer carries on.
+ *
+ * @param tree Pointer to the B+ tree.
+ * @return The snapshot, or NULL on allocation failure.
+ */
+BPTREE_API bptree_snapshot* bptree_snapshot_take(bptree* tree);
+
+/**
+ * @brief Releases a snapshot.
+ *
+ * Safe to call from any thread, concurrently with writes. Nodes that only the released
+ * snapshots could still see are recycled by the writer's next write.
+ *
+ * @param snapshot Snapshot to release, may be NULL.
+ */
+BPTREE_API void bptree_snapshot_release(bptree_snapshot* snapshot);
+
+/**
+ * @brief Looks up a key as of a snapshot.
+ *
+ * @param snapshot Snapshot to read.
+ * @param key Pointer to the key to search.
+ * @param out_value Pointer to store the retrieved value.
+ * @return BPTREE_OK if found, otherwise BPTREE_KEY_NOT_FOUND.
+ */
+BPTREE_API bptree_status bptree_snapshot_get(const bptree_snapshot* snapshot,
+                                             const bptree_key_t* key, bptree_value_t* out_value);
+
+/**
+ * @brief Positions a cursor at the start of a range of a snapshot.
+ *
+ * Works like bptree_cursor_seek(); the pairs are read with bptree_cursor_next(). Instead of
+ * the leaf chain, which writers relink, the cursor finds each next leaf from the snapshot's
+ * root, one descent per leaf.
+ *
+ * @param snapshot Snapshot to scan.
+ * @param start First key of the range, or NULL to start at the smallest key.
+ * @param end Last key of the range (inclusive), or NULL to scan to the largest key.
+ * @param cursor Cursor to initialize.
+ * @return BPTREE_OK if successful, BPTREE_INVALID_ARGUMENT if start > end.
+ */
+BPTREE_API bptree_status bptree_snapshot_cursor_seek(const bptree_snapshot* snapshot,
+                                                     const bptree_key_t* start,
+                                                     const bptree_key_t* end,
+                                                     bptree_cursor* cursor);
+
+/**
+ * @brief Turns the SIMD node search on or off for all trees.
+ *
+ * Signed 64-bit keys with the default comparison are searched with AVX2 or SSE4.2 when the
+ * CPU has them (checked once, by the first `bptree_create()`). Disabling it, or defining
+ * BPTREE_NO_SIMD at build time, leaves the scalar branch-free search; this is mainly for
+ * benchmarking.
+ *
+ * @param enable True to use SIMD where the CPU supports it.
+ */
+BPTREE_API void bptree_use_simd(bool enable);
+
 #ifdef BPTREE_IMPLEMENTATION
 
+#if !defined(BPTREE_KEY_TYPE_STRING) && defined(__x86_64__) && !defined(BPTREE_NO_SIMD)
+#define BPTREE_SIMD_SEARCH
+#include <immintrin.h>
+#endif
+
+/** @brief Keys the binary search narrows down to before the SIMD compare takes over. */
+#define BPTREE_SIMD_WINDOW 16
+
 /*==============================================================================
  * Internal Functions and Implementation Details
  *============================================================================*/
@@ -307,6 +683,62 @@ static void bptree_debug_print(const bool enable, const char* fmt, ...) {
     va_end(args);
 }
 
+/**
+ * @brief Search work done by one operation, added to the tree's counters when it finishes.
+ */
+typedef struct bptree_search_work {
+    uint64_t descents;        /**< Searches started at the root */
+    uint64_t nodes;           /**< Nodes searched */
+    uint64_t est_comparisons; /**< Estimated key comparisons */
+} bptree_search_work;
+
+/**
+ * @brief Add to one of the tree's operation counters.
+ *
+ * @param counter Counter in the tree's bptree_counters.
+ * @param n Amount to add.
+ */
+static inline void bptree_count(const uint64_t* counter, const uint64_t n) {
+#ifndef BPTREE_NO_COUNTERS
+    __atomic_fetch_add((uint64_t*)counter, n, __ATOMIC_RELAXED);
+#else
+    (void)counter;
+    (void)n;
+#endif
+}
+
+/**
+ * @brief Note a node search in an operation's work.
+ *
+ * Comparisons aren't counted inside the node searches, that would put a counter in their
+ * inner loops. They are estimated as a binary search's, one more than log2 of the key count,
+ * which is what the scalar and packed searches do; the SIMD search does fewer, wider ones.
+ *
+ * @param work The operation's work so far.
+ * @param node Node that was searched.
+ */
+static inline void bptree_search_note(bptree_search_work* work, const bptree_node* node) {
+#ifndef BPTREE_NO_COUNTERS
+    work->nodes++;
+    if (node->num_keys > 0) work->est_comparisons += 32 - __builtin_clz((unsigned)node->num_keys);
+#else
+    (void)work;
+    (void)node;
+#endif
+}
+
+/**
+ * @brief Add an operation's search work to the tree's counters.
+ *
+ * @param tree Pointer to the tree.
+ * @param work The operation's work.
+ */
+static void bptree_search_flush(const bptree* tree, const bptree_search_work* work) {
+    bptree_count(&tree->counters.descents, work->descents);
+    bptree_count(&tree->counters.nodes_visited, work->nodes);
+    bptree_count(&tree->counters.est_comparisons, work->est_comparisons);
+}
+
 /**
  * @brief Compute the size of the keys area within a node.
  *
@@ -317,7 +749,13 @@ static void bptree_debug_print(const bool enable, const char* fmt, ...) {
  * @return Size in bytes required for the keys area.
  */
 static size_t bptree_keys_area_size(const int max_keys) {
+#ifdef BPTREE_KEY_TYPE_STRING
+    // String keys live in a separate packed block.
+    const size_t keys_size = 0;
+    (void)max_keys;
+#else
     const size_t keys_size = (size_t)(max_keys + 1) * sizeof(bptree_key_t);
+#endif
     const size_t req_align = (sizeof(bptree_value_t) > sizeof(bptree_node*) ? sizeof(bptree_value_t)
                                                                             : sizeof(bptree_node*));
     // Calculate required padding to meet alignment constraints
@@ -333,7 +771,9 @@ static size_t bptree_keys_area_size(const int max_keys) {
  * @param node Pointer to the node.
  * @return Pointer to the key array.
  */
+#ifndef BPTREE_KEY_TYPE_STRING
 static bptree_key_t* bptree_node_keys(const bptree_node* node) { return (bptree_key_t*)node->data; }
+#endif
 
 /**
  * @brief Get pointer to values stored in a leaf node.
@@ -391,6 +831,169 @@ static int bptree_default_compare(const bptree_key_t* a, const bptree_key_t* b)
 }
 #endif
 
+/**
+ * @brief Compare two keys with the tree's comparator.
+ *
+ * Inlines the default numeric comparison instead of calling it through the function pointer.
+ *
+ * @param tree Pointer to the tree.
+ * @param a Pointer to the first key.
+ * @param b Pointer to the second key.
+ * @return Negative, zero or positive as *a is less than, equal to or greater than *b.
+ */
+static inline int bptree_compare_keys(const bptree* tree, const bptree_key_t* a,
+                                      const bptree_key_t* b) {
+#ifndef BPTREE_KEY_TYPE_STRING
+    if (tree->compare == bptree_default_compare) return (*a > *b) - (*a < *b);
+#endif
+    return tree->compare(a, b);
+}
+
+#ifdef BPTREE_KEY_TYPE_STRING
+/**
+ * @brief Length of a string key up to its last non-zero byte.
+ *
+ * @param key Pointer to the key.
+ * @return Number of bytes that have to be stored; the rest are zeros.
+ */
+static inline int bptree_key_length(const bptree_key_t* key) {
+    int len = BPTREE_KEY_SIZE;
+    // Skip trailing zeros a word at a time; most keys are far shorter than BPTREE_KEY_SIZE.
+    while (len >= 8) {
+        uint64_t word;
+        memcpy(&word, key->data + len - 8, sizeof(word));
+        if (word != 0) break;
+        len -= 8;
+    }
+    while (len > 0 && key->data[len - 1] == 0) len--;
+    return len;
+}
+
+/**
+ * @brief Expand one packed key back to a full key.
+ *
+ * Lengths are clamped so that a concurrent reader looking at a block that is being rewritten
+ * stays inside it; what it reads is thrown away when its version check fails.
+ *
+ * @param packed Packed keys of a node.
+ * @param i Index of the key.
+ * @param out Where to store the key.
+ */
+static inline void bptree_unpack_key(const bptree_packed_keys* packed, const int i,
+                                     bptree_key_t* out) {
+    const int key_size = (int)BPTREE_KEY_SIZE;
+    const int prefix_len = packed->prefix_len < key_size ? packed->prefix_len : key_size;
+    const int stride = packed->width;
+    const int width = stride < key_size - prefix_len ? stride : key_size - prefix_len;
+    // Byte loops rather than memcpy: both runs are a few bytes, too short to pay for the
+    // string instructions GCC emits for a bounded variable-length copy.
+    memset(out->data, 0, sizeof(out->data));
+    const char* slot = packed->slots + (size_t)i * stride;
+    for (int j = 0; j < prefix_len; j++) out->data[j] = packed->prefix[j];
+    for (int j = 0; j < width; j++) out->data[prefix_len + j] = slot[j];
+}
+
+/**
+ * @brief Check whether a key can be stored in a packed block as it is.
+ *
+ * @param packed Packed keys of a node, may be NULL.
+ * @param key Pointer to the key.
+ * @return True if the key starts with the block's prefix and ends within its width.
+ */
+static inline bool bptree_packed_fits(const bptree_packed_keys* packed, const bptree_key_t* key) {
+    return packed && memcmp(key->data, packed->prefix, packed->prefix_len) == 0 &&
+           bptree_key_length(key) <= packed->prefix_len + packed->width;
+}
+
+/**
+ * @brief Search a node of packed keys in memcmp order.
+ *
+ * The key is compared with the prefix once, then only with the width bytes of each slot.
+ * A key with non-zero bytes past prefix + width sorts after every slot it ties with.
+ *
+ * @param node Pointer to the node.
+ * @param key Pointer to the key.
+ * @return Same position as bptree_node_search().
+ */
+static int bptree_packed_search(const bptree_node* node, const bptree_key_t* key) {
+    const int n = node->num_keys;
+    const bptree_packed_keys* packed = node->packed;
+    if (n == 0 || !packed) return 0;
+    const int key_size = (int)BPTREE_KEY_SIZE;
+    const int prefix_len = packed->prefix_len < key_size ? packed->prefix_len : key_size;
+    const int stride = packed->width;
+    const int width = stride < key_size - prefix_len ? stride : key_size - prefix_len;
+    const int c = memcmp(key->data, packed->prefix, prefix_len);
+    if (c != 0) return c < 0 ? 0 : n;
+    const int tail = bptree_key_length(key) > prefix_len + width;
+    const char* rest = key->data + prefix_len;
+    // Leaves want the first key >= key, internal nodes the first key > key.
+    const int limit = node->is_leaf ? 0 : -1;
+    int low = 0, high = n;
+    while (low < high) {
+        const int mid = low + (high - low) / 2;
+        int cmp = memcmp(rest, packed->slots + (size_t)mid * stride, width);
+        if (cmp == 0) cmp = tail;
+        if (cmp <= limit) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+    return low;
+}
+#endif
+
+/**
+ * @brief Read one key of a node.
+ *
+ * @param node Pointer to the node.
+ * @param i Index of the key.
+ * @param buf Space for a packed string key to be expanded into.
+ * @return Pointer to the key, either inside the node or @p buf.
+ */
+static inline const bptree_key_t* bptree_node_key(const bptree_node* node, const int i,
+                                                  bptree_key_t* buf) {
+#ifdef BPTREE_KEY_TYPE_STRING
+    bptree_unpack_key(node->packed, i, buf);
+    return buf;
+#else
+    (void)buf;
+    return &bptree_node_keys(node)[i];
+#endif
+}
+
+/**
+ * @brief Check whether one key of a node equals a key.
+ *
+ * Packed keys in memcmp order are compared in place instead of being expanded first.
+ *
+ * @param tree Pointer to the tree.
+ * @param node Pointer to the node.
+ * @param i Index of the key, below num_keys.
+ * @param key Pointer to the key.
+ * @return True if the keys compare equal.
+ */
+static inline bool bptree_node_key_equals(const bptree* tree, const bptree_node* node, const int i,
+                                          const bptree_key_t* key) {
+#ifdef BPTREE_KEY_TYPE_STRING
+    if (tree->compare == bptree_default_compare) {
+        const bptree_packed_keys* packed = node->packed;
+        const int key_size = (int)BPTREE_KEY_SIZE;
+        const int prefix_len = packed->prefix_len < key_size ? packed->prefix_len : key_size;
+        const int stride = packed->width;
+        const int width = stride < key_size - prefix_len ? stride : key_size - prefix_len;
+        return memcmp(key->data, packed->prefix, prefix_len) == 0 &&
+               memcmp(key->data + prefix_len, packed->slots + (size_t)i * stride, width) == 0 &&
+               bptree_key_length(key) <= prefix_len + width;
+    }
+    bptree_key_t buf;
+    return tree->compare(key, bptree_node_key(node, i, &buf)) == 0;
+#else
+    return bptree_compare_keys(tree, key, &bptree_node_keys(node)[i]) == 0;
+#endif
+}
+
 /**
  * @brief Find the smallest key in a subtree.
  *
@@ -408,7 +1011,8 @@ static bptree_key_t bptree_find_smallest_key(bptree_node* node, const int max_ke
         assert(node != NULL);
     }
     assert(node->num_keys > 0);
-    return bptree_node_keys(node)[0];
+    bptree_key_t key;
+    return *bptree_node_key(node, 0, &key);
 }
 
 /**
@@ -428,27 +1032,8 @@ static bptree_key_t bptree_find_largest_key(bptree_node* node, const int max_key
         assert(node != NULL);
     }
     assert(node->num_keys > 0);
-    return bptree_node_keys(node)[node->num_keys - 1];
-}
-
-/**
- * @brief Count the total number of nodes in the subtree.
- *
- * Recursively traverses the subtree to count each node.
- *
- * @param node Pointer to the current node.
- * @param tree Pointer to the tree (for configuration values).
- * @return Total count of nodes.
- */
-static int bptree_count_nodes(const bptree_node* node, const bptree* tree) {
-    if (!node) return 0;
-    if (node->is_leaf) return 1;
-    int count = 1;  // Count the current internal node
-    bptree_node** children = bptree_node_children((bptree_node*)node, tree->max_keys);
-    for (int i = 0; i <= node->num_keys; i++) {
-        count += bptree_count_nodes(children[i], tree);
-    }
-    return count;
+    bptree_key_t key;
+    return *bptree_node_key(node, node->num_keys - 1, &key);
 }
 
 /**
@@ -465,12 +1050,23 @@ static int bptree_count_nodes(const bptree_node* node, const bptree* tree) {
 static bool bptree_check_invariants_node(bptree_node* node, const bptree* tree, const int depth,
                                          int* leaf_depth) {
     if (!node) return false;
-    const bptree_key_t* keys = bptree_node_keys(node);
     const bool is_root = (tree->root == node);
+    bptree_key_t key_buf, prev_buf;
+#ifdef BPTREE_KEY_TYPE_STRING
+    const bptree_packed_keys* packed = node->packed;
+    if (node->num_keys > 0 &&
+        (!packed || packed->prefix_len + packed->width > BPTREE_KEY_SIZE ||
+         packed->width > packed->size_class * BPTREE_PACK_GRANULE)) {
+        bptree_debug_print(tree->enable_debug, "Invariant Fail: Bad packed keys in node %p\n",
+                           (void*)node);
+        return false;
+    }
+#endif
 
     // Check that keys are in sorted order.
     for (int i = 1; i < node->num_keys; i++) {
-        if (tree->compare(&keys[i - 1], &keys[i]) >= 0) {
+        if (bptree_compare_keys(tree, bptree_node_key(node, i - 1, &prev_buf),
+                                bptree_node_key(node, i, &key_buf)) >= 0) {
             bptree_debug_print(tree->enable_debug, "Invariant Fail: Keys not sorted in node %p\n",
                                (void*)node);
             return false;
@@ -544,18 +1140,19 @@ static bool bptree_check_invariants_node(bptree_node* node, const bptree* tree,
             if (node->num_keys > 0 && (children[0]->num_keys > 0 || !children[0]->is_leaf)) {
                 const bptree_key_t max_in_child0 =
                     bptree_find_largest_key(children[0], tree->max_keys);
-                if (tree->compare(&max_in_child0, &keys[0]) >= 0) {
+                const bptree_key_t* key0 = bptree_node_key(node, 0, &key_buf);
+                if (bptree_compare_keys(tree, &max_in_child0, key0) >= 0) {
 #ifdef BPTREE_KEY_TYPE_STRING
                     bptree_debug_print(tree->enable_debug,
                                        "Invariant Fail: max(child[0]) >= key[0] in node %p -- "
                                        "MaxChild=%.*s Key=%.*s\n",
                                        (void*)node, (int)BPTREE_KEY_SIZE, max_in_child0.data,
-                                       (int)BPTREE_KEY_SIZE, keys[0].data);
+                                       (int)BPTREE_KEY_SIZE, key0->data);
 #else
                     bptree_debug_print(tree->enable_debug,
                                        "Invariant Fail: max(child[0]) >= key[0] in node %p -- "
                                        "MaxChild=%lld Key=%lld\n",
-                                       (void*)node, (long long)max_in_child0, (long long)keys[0]);
+                                       (void*)node, (long long)max_in_child0, (long long)*key0);
 #endif
                     return false;
                 }
@@ -573,7 +1170,14 @@ static bool bptree_check_invariants_node(bptree_node* node, const bptree* tree,
                 if (children[i]->num_keys > 0 || !children[i]->is_leaf) {
                     bptree_key_t min_in_child =
                         bptree_find_smallest_key(children[i], tree->max_keys);
-                    if (tree->compare(&keys[i - 1], &min_in_child) != 0) {
+                    const int cmp = bptree_compare_keys(
+                        tree, bptree_node_key(node, i - 1, &key_buf), &min_in_child);
+#ifdef BPTREE_KEY_TYPE_STRING
+                    // Separators may be cut short (see bptree_separator()).
+                    if (cmp > 0) {
+#else
+                    if (cmp != 0) {
+#endif
                         bptree_debug_print(tree->enable_debug,
                                            "Invariant Fail: key[%d] != min(child[%d]) in node %p\n",
                                            i - 1, i, (void*)node);
@@ -582,7 +1186,8 @@ static bool bptree_check_invariants_node(bptree_node* node, const bptree* tree,
                     if (i < node->num_keys) {
                         bptree_key_t max_in_child =
                             bptree_find_largest_key(children[i], tree->max_keys);
-                        if (tree->compare(&max_in_child, &keys[i]) >= 0) {
+                        if (bptree_compare_keys(tree, &max_in_child,
+                                                bptree_node_key(node, i, &key_buf)) >= 0) {
                             bptree_debug_print(
                                 tree->enable_debug,
                                 "Invariant Fail: max(child[%d]) >= key[%d] in node %p\n", i, i,
@@ -618,12 +1223,11 @@ static bool bptree_check_invariants_node(bptree_node* node, const bptree* tree,
  * Determines the memory required for a node including its header,
  * keys area, and either the child pointers area (for internals) or the values area (for leaves).
  *
- * @param tree Pointer to the tree structure.
+ * @param max_keys Maximum number of keys per node.
  * @param is_leaf True if node is a leaf.
  * @return Size in bytes required for the node allocation.
  */
-static size_t bptree_node_alloc_size(const bptree* tree, const bool is_leaf) {
-    const int max_keys = tree->max_keys;
+static size_t bptree_node_alloc_size(const int max_keys, const bool is_leaf) {
     const size_t keys_area_sz = bptree_keys_area_size(max_keys);
     size_t data_payload_size;
     if (is_leaf) {
@@ -636,15 +1240,13 @@ static size_t bptree_node_alloc_size(const bptree* tree, const bool is_leaf) {
 }
 
 /**
- * @brief Allocate a new node.
+ * @brief Alignment of a node in its pool.
  *
- * Allocates memory for a node (leaf or internal) with proper alignment.
- *
- * @param tree Pointer to the tree.
- * @param is_leaf True if the node should be a leaf.
- * @return Pointer to the allocated node, or NULL on failure.
+ * @param size Allocation size of the node.
+ * @param is_leaf True if node is a leaf.
+ * @return The alignment, a power of two.
  */
-static bptree_node* bptree_node_alloc(const bptree* tree, const bool is_leaf) {
+static size_t bptree_node_alignment(const size_t size, const bool is_leaf) {
     size_t max_align = alignof(bptree_node);
     max_align = (max_align > alignof(bptree_key_t)) ? max_align : alignof(bptree_key_t);
     if (is_leaf) {
@@ -652,28 +1254,554 @@ static bptree_node* bptree_node_alloc(const bptree* tree, const bool is_leaf) {
     } else {
         max_align = (max_align > alignof(bptree_node*)) ? max_align : alignof(bptree_node*);
     }
-    size_t size = bptree_node_alloc_size(tree, is_leaf);
-    // Adjust size to be a multiple of the required alignment.
-    size = (size + max_align - 1) & ~(max_align - 1);
-    bptree_node* node = aligned_alloc(max_align, size);
-    if (node) {
-        node->is_leaf = is_leaf;
-        node->num_keys = 0;
-        node->next = NULL;
-    } else {
-        bptree_debug_print(tree->enable_debug, "Node allocation failed (size: %zu, align: %zu)\n",
-                           size, max_align);
-    }
-    return node;
+    // The slab header holds a pointer, so nodes must be at least pointer aligned.
+    max_align = (max_align > alignof(void*)) ? max_align : alignof(void*);
+    // A node spanning n cache lines would touch n + 1 of them if it started mid-line.
+    if (size >= BPTREE_CACHE_LINE && max_align < BPTREE_CACHE_LINE) max_align = BPTREE_CACHE_LINE;
+    return max_align;
 }
 
 /**
- * @brief Recursively free a node and its children.
+ * @brief Size of a node in its pool, the allocation size rounded up to the alignment.
  *
- * Frees the memory for a node. For internal nodes, it recurses into all child nodes.
+ * @param max_keys Maximum number of keys per node.
+ * @param is_leaf True if node is a leaf.
+ * @return Bytes per node.
+ */
+static size_t bptree_node_pool_size(const int max_keys, const bool is_leaf) {
+    const size_t size = bptree_node_alloc_size(max_keys, is_leaf);
+    const size_t align = bptree_node_alignment(size, is_leaf);
+    return (size + align - 1) & ~(align - 1);
+}
+
+/**
+ * @brief Set up an empty node pool for one kind of node.
  *
- * @param node Pointer to the node to free.
- * @param tree Pointer to the tree.
+ * @param tree Pointer to the tree (only max_keys is used).
+ * @param pool Pool to initialize.
+ * @param is_leaf True if the pool holds leaves.
+ */
+static void bptree_pool_init(const bptree* tree, bptree_node_pool* pool, const bool is_leaf) {
+    pool->node_size = bptree_node_pool_size(tree->max_keys, is_leaf);
+    pool->align = bptree_node_alignment(bptree_node_alloc_size(tree->max_keys, is_leaf), is_leaf);
+    pool->bump = NULL;
+    pool->bump_end = NULL;
+    pool->free_list = NULL;
+    pool->slabs = NULL;
+    pool->reserved = 0;
+}
+
+#ifdef BPTREE_KEY_TYPE_STRING
+/**
+ * @brief Set up one packed key pool per width class.
+ *
+ * Class c holds blocks with max_keys + 1 slots of up to c * BPTREE_PACK_GRANULE bytes.
+ *
+ * @param tree Pointer to the tree.
+ */
+static void bptree_key_pools_init(bptree* tree) {
+    const size_t align = alignof(bptree_node);
+    for (int c = 0; c < BPTREE_PACK_CLASSES; c++) {
+        bptree_node_pool* pool = &tree->key_pools[c];
+        size_t size = offsetof(bptree_packed_keys, slots) +
+                      (size_t)(tree->max_keys + 1) * c * BPTREE_PACK_GRANULE;
+        // The pool code links free blocks through the node header, so none may be smaller.
+        if (size < sizeof(bptree_node)) size = sizeof(bptree_node);
+        pool->node_size = (size + align - 1) & ~(align - 1);
+        pool->align = align;
+        pool->bump = NULL;
+        pool->bump_end = NULL;
+        pool->free_list = NULL;
+        pool->slabs = NULL;
+        pool->reserved = 0;
+    }
+}
+#endif
+
+/**
+ * @brief Take a node from a pool.
+ *
+ * Reuses a released node if there is one, otherwise bumps into the newest slab, and
+ * allocates a new slab of about BPTREE_SLAB_SIZE bytes when that one is used up.
+ *
+ * @param pool Pool to allocate from.
+ * @return Pointer to uninitialized node memory, or NULL on failure.
+ */
+static bptree_node* bptree_pool_alloc(bptree_node_pool* pool) {
+    if (pool->free_list) {
+        bptree_node* node = pool->free_list;
+        pool->free_list = node->next;
+        // Recycled nodes keep their version and count on from it, so a stale reader can't
+        // mistake one for its old self.
+        return node;
+    }
+    if (pool->bump == pool->bump_end) {
+        const size_t header = (sizeof(void*) + pool->align - 1) & ~(pool->align - 1);
+        size_t nodes = (BPTREE_SLAB_SIZE - header) / pool->node_size;
+        if (BPTREE_SLAB_SIZE < header || nodes < 1) nodes = 1;
+        void* slab = aligned_alloc(pool->align, header + nodes * pool->node_size);
+        if (!slab) return NULL;
+        pool->reserved += header + nodes * pool->node_size;
+        *(void**)slab = pool->slabs;
+        pool->slabs = slab;
+        pool->bump = (char*)slab + header;
+        pool->bump_end = pool->bump + nodes * pool->node_size;
+    }
+    bptree_node* node = (bptree_node*)pool->bump;
+    pool->bump += pool->node_size;
+    // Fresh memory has never been read, so its version starts at 0.
+    node->version = 0;
+    return node;
+}
+
+/**
+ * @brief Return every slab of a pool to the system.
+ *
+ * @param pool Pool to release; it is left empty and can be reused.
+ */
+static void bptree_pool_destroy(bptree_node_pool* pool) {
+    void* slab = pool->slabs;
+    while (slab) {
+        void* prev = *(void**)slab;
+        free(slab);
+        slab = prev;
+    }
+    pool->slabs = NULL;
+    pool->bump = NULL;
+    pool->bump_end = NULL;
+    pool->free_list = NULL;
+    pool->reserved = 0;
+}
+
+/**
+ * @brief Allocate a new node.
+ *
+ * Takes a node (leaf or internal) from the tree's pool for that kind of node.
+ *
+ * @param tree Pointer to the tree.
+ * @param is_leaf True if the node should be a leaf.
+ * @return Pointer to the allocated node, or NULL on failure.
+ */
+static bptree_node* bptree_node_alloc(bptree* tree, const bool is_leaf) {
+    bptree_node_pool* pool = is_leaf ? &tree->leaf_pool : &tree->internal_pool;
+    // Concurrent inserts can split in different subtrees at the same time.
+    while (__atomic_test_and_set(&tree->pool_latch, __ATOMIC_ACQUIRE)) {
+    }
+    bptree_node* node = bptree_pool_alloc(pool);
+    __atomic_clear(&tree->pool_latch, __ATOMIC_RELEASE);
+    if (node) {
+        __atomic_fetch_add(is_leaf ? &tree->leaf_nodes : &tree->internal_nodes, 1,
+                           __ATOMIC_RELAXED);
+        node->is_leaf = is_leaf;
+        node->num_keys = 0;
+        node->next = NULL;
+        node->gen = tree->gen;
+#ifdef BPTREE_KEY_TYPE_STRING
+        node->packed = NULL;
+#endif
+    } else {
+        bptree_debug_print(tree->enable_debug, "Node allocation failed (size: %zu, align: %zu)\n",
+                           pool->node_size, pool->align);
+    }
+    return node;
+}
+
+#ifdef BPTREE_KEY_TYPE_STRING
+/**
+ * @brief Take a packed key block from the pool for its width class.
+ *
+ * @param tree Pointer to the tree.
+ * @param size_class Width class, 0 to BPTREE_PACK_CLASSES - 1.
+ * @return Pointer to the block, or NULL on failure.
+ */
+static bptree_packed_keys* bptree_key_block_alloc(bptree* tree, const int size_class) {
+    while (__atomic_test_and_set(&tree->pool_latch, __ATOMIC_ACQUIRE)) {
+    }
+    bptree_packed_keys* packed =
+        (bptree_packed_keys*)bptree_pool_alloc(&tree->key_pools[size_class]);
+    __atomic_clear(&tree->pool_latch, __ATOMIC_RELEASE);
+    if (packed) packed->size_class = (uint16_t)size_class;
+    return packed;
+}
+
+/**
+ * @brief Return a packed key block to its pool.
+ *
+ * @param tree Pointer to the tree.
+ * @param packed Block to release.
+ */
+static void bptree_key_block_release(bptree* tree, bptree_packed_keys* packed) {
+    bptree_node_pool* pool = &tree->key_pools[packed->size_class];
+    bptree_node* block = (bptree_node*)packed;
+    while (__atomic_test_and_set(&tree->pool_latch, __ATOMIC_ACQUIRE)) {
+    }
+    block->next = pool->free_list;
+    pool->free_list = block;
+    __atomic_clear(&tree->pool_latch, __ATOMIC_RELEASE);
+}
+#endif
+
+/**
+ * @brief Release a single node back to its pool.
+ *
+ * The memory stays with the tree and is handed out again by the next allocation.
+ *
+ * @param node Pointer to the node to release.
+ * @param tree Pointer to the tree.
+ */
+static void bptree_node_release(bptree_node* node, bptree* tree) {
+#ifdef BPTREE_KEY_TYPE_STRING
+    if (node->packed) bptree_key_block_release(tree, node->packed);
+    node->packed = NULL;
+#endif
+    __atomic_fetch_sub(node->is_leaf ? &tree->leaf_nodes : &tree->internal_nodes, 1,
+                       __ATOMIC_RELAXED);
+    bptree_node_pool* pool = node->is_leaf ? &tree->leaf_pool : &tree->internal_pool;
+    // A concurrent insert hands back the new node of a split that failed part way, while
+    // other writers may be allocating.
+    while (__atomic_test_and_set(&tree->pool_latch, __ATOMIC_ACQUIRE)) {
+    }
+    node->next = pool->free_list;
+    pool->free_list = node;
+    __atomic_clear(&tree->pool_latch, __ATOMIC_RELEASE);
+}
+
+#ifdef BPTREE_KEY_TYPE_STRING
+/**
+ * @brief Store a run of keys in a node, prefix-compressed.
+ *
+ * Finds the prefix every key shares and the longest key, and keeps the node's block if it
+ * has the right width class, otherwise swaps it for a block from the right pool.
+ *
+ * @param tree Pointer to the tree.
+ * @param node Node whose keys are replaced.
+ * @param keys Keys in tree order.
+ * @param n Number of keys, at most max_keys + 1.
+ * @return BPTREE_OK, or BPTREE_ALLOCATION_FAILURE with the node left as it was.
+ */
+static bptree_status bptree_pack_keys(bptree* tree, bptree_node* node, const bptree_key_t* keys,
+                                      const int n) {
+    bptree_packed_keys* packed = node->packed;
+    if (n == 0) {
+        if (packed) bptree_key_block_release(tree, packed);
+        node->packed = NULL;
+        return BPTREE_OK;
+    }
+    int prefix_len = bptree_key_length(&keys[0]);
+    int length = prefix_len;
+    for (int i = 1; i < n; i++) {
+        int common = 0;
+        while (common < prefix_len && keys[i].data[common] == keys[0].data[common]) common++;
+        prefix_len = common;
+        const int len = bptree_key_length(&keys[i]);
+        if (len > length) length = len;
+    }
+    const int width = length - prefix_len;
+    const int size_class = (width + BPTREE_PACK_GRANULE - 1) / BPTREE_PACK_GRANULE;
+    if (!packed || packed->size_class != size_class) {
+        bptree_packed_keys* fresh = bptree_key_block_alloc(tree, size_class);
+        if (!fresh) return BPTREE_ALLOCATION_FAILURE;
+        if (packed) bptree_key_block_release(tree, packed);
+        packed = fresh;
+    }
+    packed->prefix_len = (uint16_t)prefix_len;
+    packed->width = (uint16_t)width;
+    memcpy(packed->prefix, keys[0].data, prefix_len);
+    for (int i = 0; i < n; i++) {
+        memcpy(packed->slots + (size_t)i * width, keys[i].data + prefix_len, width);
+    }
+    // Release so concurrent readers that load the new block see it filled in.
+    __atomic_store_n(&node->packed, packed, __ATOMIC_RELEASE);
+    return BPTREE_OK;
+}
+#endif
+
+/**
+ * @brief Get a node's keys as a plain array to edit.
+ *
+ * Numeric keys are edited in place. Packed string keys are expanded into a new array, which
+ * bptree_keys_write() packs back into the node and bptree_keys_close() frees.
+ *
+ * @param tree Pointer to the tree.
+ * @param node Pointer to the node.
+ * @return Array with room for max_keys + 1 keys, or NULL if it could not be allocated.
+ */
+static bptree_key_t* bptree_keys_open(const bptree* tree, const bptree_node* node) {
+#ifdef BPTREE_KEY_TYPE_STRING
+    bptree_key_t* keys = malloc((size_t)(tree->max_keys + 1) * sizeof(bptree_key_t));
+    if (!keys) return NULL;
+    for (int i = 0; i < node->num_keys; i++) bptree_unpack_key(node->packed, i, &keys[i]);
+    return keys;
+#else
+    (void)tree;
+    return bptree_node_keys(node);
+#endif
+}
+
+/**
+ * @brief Make a node's keys the first n of an array.
+ *
+ * @param tree Pointer to the tree.
+ * @param node Pointer to the node.
+ * @param keys Keys in tree order; may be the node's own array from bptree_keys_open().
+ * @param n Number of keys.
+ * @return BPTREE_OK, or BPTREE_ALLOCATION_FAILURE if packed keys needed a block that could not
+ *         be allocated (the node is then unchanged).
+ */
+static bptree_status bptree_keys_write(bptree* tree, bptree_node* node, const bptree_key_t* keys,
+                                       const int n) {
+#ifdef BPTREE_KEY_TYPE_STRING
+    return bptree_pack_keys(tree, node, keys, n);
+#else
+    (void)tree;
+    bptree_key_t* node_keys = bptree_node_keys(node);
+    if (keys != node_keys && n > 0) memmove(node_keys, keys, (size_t)n * sizeof(bptree_key_t));
+    return BPTREE_OK;
+#endif
+}
+
+/**
+ * @brief Free an array from bptree_keys_open().
+ *
+ * @param keys Array to free, may be NULL.
+ */
+static void bptree_keys_close(bptree_key_t* keys) {
+#ifdef BPTREE_KEY_TYPE_STRING
+    free(keys);
+#else
+    (void)keys;
+#endif
+}
+
+/**
+ * @brief bptree_keys_open() for rebalancing, which has no way to report a failure.
+ *
+ * @param tree Pointer to the tree.
+ * @param node Pointer to the node.
+ * @return The node's keys.
+ */
+static bptree_key_t* bptree_keys_open_or_abort(const bptree* tree, const bptree_node* node) {
+    bptree_key_t* keys = bptree_keys_open(tree, node);
+    if (!keys) {
+        fprintf(stderr, "[BPTree FATAL] Out of memory for packed keys while rebalancing.\n");
+        abort();
+    }
+    return keys;
+}
+
+/**
+ * @brief Write keys back and close them after a rebalance, aborting if that fails.
+ *
+ * @param tree Pointer to the tree.
+ * @param node Pointer to the node.
+ * @param keys Array from bptree_keys_open_or_abort(), or NULL when n is 0.
+ * @param n Number of keys.
+ */
+static void bptree_keys_finish(bptree* tree, bptree_node* node, bptree_key_t* keys, const int n) {
+    if (bptree_keys_write(tree, node, keys, n) != BPTREE_OK) {
+        fprintf(stderr, "[BPTree FATAL] Out of memory for packed keys while rebalancing.\n");
+        abort();
+    }
+    bptree_keys_close(keys);
+}
+
+/**
+ * @brief Insert a key into a node with room for it, shifting the keys from pos on.
+ *
+ * Only the keys move; the caller shifts values or children and updates num_keys.
+ *
+ * @param node Pointer to the node.
+ * @param pos Position of the new key.
+ * @param key Pointer to the key.
+ * @return False, with nothing changed, if the key doesn't fit a packed node's prefix and
+ *         width; the node then has to be rewritten with bptree_keys_write().
+ */
+static bool bptree_keys_insert_at(bptree_node* node, const int pos, const bptree_key_t* key) {
+#ifdef BPTREE_KEY_TYPE_STRING
+    bptree_packed_keys* packed = node->packed;
+    if (!bptree_packed_fits(packed, key)) return false;
+    const int width = packed->width;
+    char* slot = packed->slots + (size_t)pos * width;
+    memmove(slot + width, slot, (size_t)(node->num_keys - pos) * width);
+    memcpy(slot, key->data + packed->prefix_len, width);
+#else
+    bptree_key_t* keys = bptree_node_keys(node);
+    memmove(&keys[pos + 1], &keys[pos], (node->num_keys - pos) * sizeof(bptree_key_t));
+    keys[pos] = *key;
+#endif
+    return true;
+}
+
+/**
+ * @brief Remove the key at pos, shifting the keys after it down.
+ *
+ * @param node Pointer to the node.
+ * @param pos Position of the key.
+ */
+static void bptree_keys_remove_at(bptree_node* node, const int pos) {
+#ifdef BPTREE_KEY_TYPE_STRING
+    bptree_packed_keys* packed = node->packed;
+    const int width = packed->width;
+    char* slot = packed->slots + (size_t)pos * width;
+    memmove(slot, slot + width, (size_t)(node->num_keys - pos - 1) * width);
+#else
+    bptree_key_t* keys = bptree_node_keys(node);
+    memmove(&keys[pos], &keys[pos + 1], (node->num_keys - pos - 1) * sizeof(bptree_key_t));
+#endif
+}
+
+/**
+ * @brief Choose the key a leaf split pushes into the parent.
+ *
+ * Any key above the left leaf's last key and not above the right leaf's first one separates
+ * them. With the default string order the shortest one is the right key cut one byte past
+ * where the two differ, which packs into fewer bytes in every node above.
+ *
+ * @param tree Pointer to the tree.
+ * @param left Last key of the left leaf.
+ * @param right First key of the right leaf.
+ * @return The separator.
+ */
+static bptree_key_t bptree_separator(const bptree* tree, const bptree_key_t* left,
+                                     const bptree_key_t* right) {
+    bptree_key_t separator = *right;
+#ifdef BPTREE_KEY_TYPE_STRING
+    if (tree->compare == bptree_default_compare) {
+        int common = 0;
+        while (common < (int)BPTREE_KEY_SIZE && left->data[common] == right->data[common]) common++;
+        if (common + 1 < (int)BPTREE_KEY_SIZE) {
+            memset(separator.data + common + 1, 0, BPTREE_KEY_SIZE - common - 1);
+        }
+    }
+#else
+    (void)tree;
+    (void)left;
+#endif
+    return separator;
+}
+
+/**
+ * @brief Whether a live snapshot may be reading a node.
+ *
+ * Nodes allocated since the newest snapshot belong to the writer alone. Without snapshots
+ * snapshot_gen is 0, and every node is the writer's.
+ *
+ * @param tree Pointer to the tree.
+ * @param node Pointer to the node.
+ * @return True if the node must be copied before it is changed.
+ */
+static inline bool bptree_node_shared(const bptree* tree, const bptree_node* node) {
+    return node->gen <= tree->snapshot_gen;
+}
+
+/**
+ * @brief Copy a node, packed keys included.
+ *
+ * @param tree Pointer to the tree.
+ * @param node Node to copy.
+ * @return The copy, stamped with the current generation, or NULL on allocation failure.
+ */
+static bptree_node* bptree_node_copy(bptree* tree, const bptree_node* node) {
+    bptree_node* copy = bptree_node_alloc(tree, node->is_leaf);
+    if (!copy) return NULL;
+#ifdef BPTREE_KEY_TYPE_STRING
+    if (node->packed) {
+        const int size_class = node->packed->size_class;
+        copy->packed = bptree_key_block_alloc(tree, size_class);
+        if (!copy->packed) {
+            bptree_node_release(copy, tree);
+            return NULL;
+        }
+        memcpy(copy->packed, node->packed, tree->key_pools[size_class].node_size);
+    }
+#endif
+    const int n = node->num_keys;
+    copy->num_keys = n;
+    copy->next = node->next;
+    // Only the slots in use; a half-full page-sized node is half the copy.
+#ifndef BPTREE_KEY_TYPE_STRING
+    memcpy(bptree_node_keys(copy), bptree_node_keys(node), (size_t)n * sizeof(bptree_key_t));
+#endif
+    if (node->is_leaf) {
+        memcpy(bptree_node_values(copy, tree->max_keys),
+               bptree_node_values((bptree_node*)node, tree->max_keys),
+               (size_t)n * sizeof(bptree_value_t));
+    } else {
+        memcpy(bptree_node_children(copy, tree->max_keys),
+               bptree_node_children((bptree_node*)node, tree->max_keys),
+               (size_t)(n + 1) * sizeof(bptree_node*));
+    }
+    return copy;
+}
+
+/**
+ * @brief Drop a node the live tree no longer uses.
+ *
+ * A node no snapshot can see goes straight back to its pool. A shared one is queued with
+ * the current generation and recycled by bptree_reclaim() once the snapshots older than
+ * that are gone.
+ *
+ * @param tree Pointer to the tree.
+ * @param node Node to drop.
+ */
+static void bptree_node_discard(bptree* tree, bptree_node* node) {
+    if (!bptree_node_shared(tree, node)) {
+        bptree_node_release(node, tree);
+        return;
+    }
+    if (tree->retired_count == tree->retired_capacity) {
+        const int capacity = tree->retired_capacity ? tree->retired_capacity * 2 : 64;
+        bptree_retired_node* grown =
+            realloc(tree->retired, (size_t)capacity * sizeof(bptree_retired_node));
+        // Without room to queue it, the node stays in its slab until bptree_free().
+        if (!grown) return;
+        tree->retired = grown;
+        tree->retired_capacity = capacity;
+    }
+    tree->retired[tree->retired_count].node = node;
+    tree->retired[tree->retired_count].gen = tree->gen;
+    tree->retired_count++;
+}
+
+/**
+ * @brief Recycle queued nodes that no live snapshot can see any more.
+ *
+ * The writer calls this at the start of every write. It costs one load unless a snapshot
+ * was released since, and it is also where the writer stops copying once none are left.
+ *
+ * @param tree Pointer to the tree.
+ */
+static void bptree_reclaim(bptree* tree) {
+    if (!__atomic_load_n(&tree->snapshot_released, __ATOMIC_RELAXED)) return;
+    while (__atomic_test_and_set(&tree->snapshot_latch, __ATOMIC_ACQUIRE)) {
+    }
+    __atomic_store_n(&tree->snapshot_released, false, __ATOMIC_RELAXED);
+    const uint64_t oldest = tree->oldest_snapshot ? tree->oldest_snapshot->gen : UINT64_MAX;
+    tree->snapshot_gen = tree->newest_snapshot ? tree->newest_snapshot->gen : 0;
+    __atomic_clear(&tree->snapshot_latch, __ATOMIC_RELEASE);
+    // A node replaced in generation g is only seen by snapshots taken before g.
+    int freed = 0;
+    while (freed < tree->retired_count && tree->retired[freed].gen <= oldest) {
+        bptree_node_release(tree->retired[freed].node, tree);
+        freed++;
+    }
+    // Nothing may have been retired at all, and then retired is still NULL.
+    if (freed > 0) {
+        tree->retired_count -= freed;
+        memmove(tree->retired, tree->retired + freed,
+                (size_t)tree->retired_count * sizeof(bptree_retired_node));
+        bptree_debug_print(tree->enable_debug, "Reclaimed %d nodes replaced under snapshots.\n",
+                           freed);
+    }
+}
+
+/**
+ * @brief Recursively free a node and its children.
+ *
+ * Releases a node to its pool. For internal nodes, it recurses into all child nodes.
+ *
+ * @param node Pointer to the node to free.
+ * @param tree Pointer to the tree.
  */
 static void bptree_free_node(bptree_node* node, bptree* tree) {
     if (!node) return;
@@ -683,9 +1811,14 @@ static void bptree_free_node(bptree_node* node, bptree* tree) {
             bptree_free_node(children[i], tree);
         }
     }
-    free(node);
+    bptree_node_release(node, tree);
 }
 
+/**
+ * @brief Declared here for rebalancing, defined with the other copy-on-write helpers below.
+ */
+static bptree_node* bptree_cow_or_abort(bptree* tree, bptree_node* parent, int pos);
+
 /**
  * @brief Rebalance the tree upward from a given node.
  *
@@ -723,11 +1856,12 @@ static void bptree_rebalance_up(bptree* tree, bptree_node** node_stack, const in
             if (left_sibling->num_keys > left_min) {
                 bptree_debug_print(tree->enable_debug,
                                    "Attempting borrow from left sibling (idx %d)\n", child_idx - 1);
-                bptree_key_t* parent_keys = bptree_node_keys(parent);
+                left_sibling = bptree_cow_or_abort(tree, parent, child_idx - 1);
+                bptree_key_t* parent_keys = bptree_keys_open_or_abort(tree, parent);
+                bptree_key_t* child_keys = bptree_keys_open_or_abort(tree, child);
+                bptree_key_t* left_keys = bptree_keys_open_or_abort(tree, left_sibling);
                 if (child->is_leaf) {
-                    bptree_key_t* child_keys = bptree_node_keys(child);
                     bptree_value_t* child_vals = bptree_node_values(child, tree->max_keys);
-                    const bptree_key_t* left_keys = bptree_node_keys(left_sibling);
                     const bptree_value_t* left_vals =
                         bptree_node_values(left_sibling, tree->max_keys);
                     // Shift keys and values right to open space at index 0.
@@ -737,18 +1871,13 @@ static void bptree_rebalance_up(bptree* tree, bptree_node** node_stack, const in
                     // Move the last key/value from the left sibling.
                     child_keys[0] = left_keys[left_sibling->num_keys - 1];
                     child_vals[0] = left_vals[left_sibling->num_keys - 1];
-                    child->num_keys++;
-                    left_sibling->num_keys--;
                     // Update the parent separator.
                     parent_keys[child_idx - 1] = child_keys[0];
                     bptree_debug_print(tree->enable_debug,
                                        "Borrowed leaf key from left. Parent key updated.\n");
-                    break;
                 } else {
                     // Internal node case: shift keys and children to insert the borrowed key.
-                    bptree_key_t* child_keys = bptree_node_keys(child);
                     bptree_node** child_children = bptree_node_children(child, tree->max_keys);
-                    bptree_key_t* left_keys = bptree_node_keys(left_sibling);
                     bptree_node** left_children =
                         bptree_node_children(left_sibling, tree->max_keys);
                     memmove(&child_keys[1], &child_keys[0], child->num_keys * sizeof(bptree_key_t));
@@ -757,13 +1886,17 @@ static void bptree_rebalance_up(bptree* tree, bptree_node** node_stack, const in
                     child_keys[0] = parent_keys[child_idx - 1];
                     child_children[0] = left_children[left_sibling->num_keys];
                     parent_keys[child_idx - 1] = left_keys[left_sibling->num_keys - 1];
-                    child->num_keys++;
-                    left_sibling->num_keys--;
                     bptree_debug_print(
                         tree->enable_debug,
                         "Borrowed internal key/child from left. Parent key updated.\n");
-                    break;
                 }
+                child->num_keys++;
+                left_sibling->num_keys--;
+                bptree_keys_finish(tree, child, child_keys, child->num_keys);
+                bptree_keys_finish(tree, left_sibling, left_keys, left_sibling->num_keys);
+                bptree_keys_finish(tree, parent, parent_keys, parent->num_keys);
+                bptree_count(&tree->counters.borrows, 1);
+                break;
             }
         }
         // Try borrowing from the right sibling.
@@ -775,11 +1908,12 @@ static void bptree_rebalance_up(bptree* tree, bptree_node** node_stack, const in
                 bptree_debug_print(tree->enable_debug,
                                    "Attempting borrow from right sibling (idx %d)\n",
                                    child_idx + 1);
-                bptree_key_t* parent_keys = bptree_node_keys(parent);
+                right_sibling = bptree_cow_or_abort(tree, parent, child_idx + 1);
+                bptree_key_t* parent_keys = bptree_keys_open_or_abort(tree, parent);
+                bptree_key_t* child_keys = bptree_keys_open_or_abort(tree, child);
+                bptree_key_t* right_keys = bptree_keys_open_or_abort(tree, right_sibling);
                 if (child->is_leaf) {
-                    bptree_key_t* child_keys = bptree_node_keys(child);
                     bptree_value_t* child_vals = bptree_node_values(child, tree->max_keys);
-                    bptree_key_t* right_keys = bptree_node_keys(right_sibling);
                     bptree_value_t* right_vals = bptree_node_values(right_sibling, tree->max_keys);
                     // Borrow the first key/value from the right sibling.
                     child_keys[child->num_keys] = right_keys[0];
@@ -794,12 +1928,9 @@ static void bptree_rebalance_up(bptree* tree, bptree_node** node_stack, const in
                     parent_keys[child_idx] = right_keys[0];
                     bptree_debug_print(tree->enable_debug,
                                        "Borrowed leaf key from right. Parent key updated.\n");
-                    break;
                 } else {
                     // Internal node: borrow key and child pointer from right sibling.
-                    bptree_key_t* child_keys = bptree_node_keys(child);
                     bptree_node** child_children = bptree_node_children(child, tree->max_keys);
-                    bptree_key_t* right_keys = bptree_node_keys(right_sibling);
                     bptree_node** right_children =
                         bptree_node_children(right_sibling, tree->max_keys);
                     child_keys[child->num_keys] = parent_keys[child_idx];
@@ -814,21 +1945,26 @@ static void bptree_rebalance_up(bptree* tree, bptree_node** node_stack, const in
                     bptree_debug_print(
                         tree->enable_debug,
                         "Borrowed internal key/child from right. Parent key updated.\n");
-                    break;
                 }
+                bptree_keys_finish(tree, child, child_keys, child->num_keys);
+                bptree_keys_finish(tree, right_sibling, right_keys, right_sibling->num_keys);
+                bptree_keys_finish(tree, parent, parent_keys, parent->num_keys);
+                bptree_count(&tree->counters.borrows, 1);
+                break;
             }
         }
         // If borrowing failed, attempt a merge.
         bptree_debug_print(tree->enable_debug, "Borrow failed, attempting merge\n");
+        bptree_key_t* parent_keys = bptree_keys_open_or_abort(tree, parent);
         if (child_idx > 0) {
             // Merge with left sibling.
-            bptree_node* left_sibling = children[child_idx - 1];
+            bptree_node* left_sibling = bptree_cow_or_abort(tree, parent, child_idx - 1);
             bptree_debug_print(tree->enable_debug, "Merging child %d into left sibling %d\n",
                                child_idx, child_idx - 1);
+            bptree_key_t* left_keys = bptree_keys_open_or_abort(tree, left_sibling);
+            bptree_key_t* child_keys = bptree_keys_open_or_abort(tree, child);
             if (child->is_leaf) {
-                bptree_key_t* left_keys = bptree_node_keys(left_sibling);
                 bptree_value_t* left_vals = bptree_node_values(left_sibling, tree->max_keys);
-                const bptree_key_t* child_keys = bptree_node_keys(child);
                 const bptree_value_t* child_vals = bptree_node_values(child, tree->max_keys);
                 const int combined_keys = left_sibling->num_keys + child->num_keys;
                 if (combined_keys > tree->max_keys) {
@@ -845,14 +1981,9 @@ static void bptree_rebalance_up(bptree* tree, bptree_node** node_stack, const in
                        child->num_keys * sizeof(bptree_value_t));
                 left_sibling->num_keys = combined_keys;
                 left_sibling->next = child->next;
-                free(child);
-                children[child_idx] = NULL;
             } else {
-                bptree_key_t* left_keys = bptree_node_keys(left_sibling);
                 bptree_node** left_children = bptree_node_children(left_sibling, tree->max_keys);
-                bptree_key_t* child_keys = bptree_node_keys(child);
                 bptree_node** child_children = bptree_node_children(child, tree->max_keys);
-                bptree_key_t* parent_keys = bptree_node_keys(parent);
                 const int combined_keys = left_sibling->num_keys + 1 + child->num_keys;
                 const int combined_children = (left_sibling->num_keys + 1) + (child->num_keys + 1);
                 if (combined_keys > tree->max_keys) {
@@ -875,11 +2006,13 @@ static void bptree_rebalance_up(bptree* tree, bptree_node** node_stack, const in
                 memcpy(left_children + left_sibling->num_keys + 1, child_children,
                        (child->num_keys + 1) * sizeof(bptree_node*));
                 left_sibling->num_keys = combined_keys;
-                free(child);
-                children[child_idx] = NULL;
             }
+            bptree_keys_finish(tree, left_sibling, left_keys, left_sibling->num_keys);
+            bptree_keys_close(child_keys);
+            bptree_node_discard(tree, child);
+            bptree_count(&tree->counters.merges, 1);
+            children[child_idx] = NULL;
             // Remove the parent separator key that pointed to the merged node.
-            bptree_key_t* parent_keys = bptree_node_keys(parent);
             memmove(&parent_keys[child_idx - 1], &parent_keys[child_idx],
                     (parent->num_keys - child_idx) * sizeof(bptree_key_t));
             memmove(&children[child_idx], &children[child_idx + 1],
@@ -891,10 +2024,10 @@ static void bptree_rebalance_up(bptree* tree, bptree_node** node_stack, const in
             bptree_node* right_sibling = children[child_idx + 1];
             bptree_debug_print(tree->enable_debug, "Merging right sibling %d into child %d\n",
                                child_idx + 1, child_idx);
+            bptree_key_t* child_keys = bptree_keys_open_or_abort(tree, child);
+            bptree_key_t* right_keys = bptree_keys_open_or_abort(tree, right_sibling);
             if (child->is_leaf) {
-                bptree_key_t* child_keys = bptree_node_keys(child);
                 bptree_value_t* child_vals = bptree_node_values(child, tree->max_keys);
-                const bptree_key_t* right_keys = bptree_node_keys(right_sibling);
                 const bptree_value_t* right_vals =
                     bptree_node_values(right_sibling, tree->max_keys);
                 const int combined_keys = child->num_keys + right_sibling->num_keys;
@@ -911,14 +2044,9 @@ static void bptree_rebalance_up(bptree* tree, bptree_node** node_stack, const in
                        right_sibling->num_keys * sizeof(bptree_value_t));
                 child->num_keys = combined_keys;
                 child->next = right_sibling->next;
-                free(right_sibling);
-                children[child_idx + 1] = NULL;
             } else {
-                bptree_key_t* child_keys = bptree_node_keys(child);
                 bptree_node** child_children = bptree_node_children(child, tree->max_keys);
-                const bptree_key_t* right_keys = bptree_node_keys(right_sibling);
                 bptree_node** right_children = bptree_node_children(right_sibling, tree->max_keys);
-                const bptree_key_t* parent_keys = bptree_node_keys(parent);
                 const int combined_keys = child->num_keys + 1 + right_sibling->num_keys;
                 const int combined_children = (child->num_keys + 1) + (right_sibling->num_keys + 1);
                 if (combined_keys > tree->max_keys) {
@@ -941,10 +2069,13 @@ static void bptree_rebalance_up(bptree* tree, bptree_node** node_stack, const in
                 memcpy(child_children + child->num_keys + 1, right_children,
                        (right_sibling->num_keys + 1) * sizeof(bptree_node*));
                 child->num_keys = combined_keys;
-                free(right_sibling);
-                children[child_idx + 1] = NULL;
             }
-            bptree_key_t* parent_keys = bptree_node_keys(parent);
+            bptree_keys_finish(tree, child, child_keys, child->num_keys);
+            bptree_keys_close(right_keys);
+            // It was only read, so a shared one is queued without being copied first.
+            bptree_node_discard(tree, right_sibling);
+            bptree_count(&tree->counters.merges, 1);
+            children[child_idx + 1] = NULL;
             memmove(&parent_keys[child_idx], &parent_keys[child_idx + 1],
                     (parent->num_keys - child_idx - 1) * sizeof(bptree_key_t));
             memmove(&children[child_idx + 1], &children[child_idx + 2],
@@ -952,6 +2083,7 @@ static void bptree_rebalance_up(bptree* tree, bptree_node** node_stack, const in
             parent->num_keys--;
             bptree_debug_print(tree->enable_debug, "Merge with right complete. Parent updated.\n");
         }
+        bptree_keys_finish(tree, parent, parent_keys, parent->num_keys);
     }
     // Check for the special case where the root becomes empty and the height can be reduced.
     if (tree->root && !tree->root->is_leaf && tree->root->num_keys == 0 && tree->count > 0) {
@@ -960,17 +2092,91 @@ static void bptree_rebalance_up(bptree* tree, bptree_node** node_stack, const in
         bptree_node* old_root = tree->root;
         tree->root = bptree_node_children(old_root, tree->max_keys)[0];
         tree->height--;
-        free(old_root);
+        bptree_node_discard(tree, old_root);
     } else if (tree->count == 0 && tree->root && tree->root->num_keys != 0) {
         bptree_debug_print(tree->enable_debug, "Tree empty, ensuring root node is empty.\n");
+        bptree_keys_finish(tree, tree->root, NULL, 0);
         tree->root->num_keys = 0;
     }
 }
 
+#ifdef BPTREE_SIMD_SEARCH
+/**
+ * @brief Node search instruction set: 0 scalar, 1 SSE4.2, 2 AVX2, -1 until the first
+ * bptree_create() or bptree_use_simd() sets it. Global, so it is only read and written with
+ * atomics: trees may be created on any thread while others search.
+ */
+static int bptree_simd_level = -1;
+
+/**
+ * @brief The widest SIMD search the CPU supports.
+ */
+static int bptree_detect_simd(void) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+        return 2;
+    } else if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt")) {
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Count keys below (or not above) a key with AVX2, four keys per compare.
+ *
+ * @param keys Sorted keys.
+ * @param n Number of keys.
+ * @param k Key to compare against.
+ * @param or_equal Count keys <= k instead of keys < k.
+ * @return The number of matching keys, which is also the search position.
+ */
+__attribute__((target("avx2,popcnt"))) static int bptree_count_below_avx2(const int64_t* keys,
+                                                                          const int n,
+                                                                          const int64_t k,
+                                                                          const bool or_equal) {
+    const __m256i needle = _mm256_set1_epi64x(k);
+    int count = 0;
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m256i v = _mm256_loadu_si256((const __m256i*)(keys + i));
+        // Keys < k, or for or_equal the complement of keys > k.
+        const __m256i hits = or_equal ? _mm256_cmpgt_epi64(v, needle)
+                                      : _mm256_cmpgt_epi64(needle, v);
+        const int bits = __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(hits)));
+        count += or_equal ? 4 - bits : bits;
+    }
+    for (; i < n; i++) count += or_equal ? keys[i] <= k : keys[i] < k;
+    return count;
+}
+
+/**
+ * @brief SSE4.2 version of bptree_count_below_avx2(), two keys per compare.
+ */
+__attribute__((target("sse4.2,popcnt"))) static int bptree_count_below_sse42(const int64_t* keys,
+                                                                             const int n,
+                                                                             const int64_t k,
+                                                                             const bool or_equal) {
+    const __m128i needle = _mm_set1_epi64x(k);
+    int count = 0;
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        const __m128i v = _mm_loadu_si128((const __m128i*)(keys + i));
+        const __m128i hits = or_equal ? _mm_cmpgt_epi64(v, needle) : _mm_cmpgt_epi64(needle, v);
+        const int bits = __builtin_popcount(_mm_movemask_pd(_mm_castsi128_pd(hits)));
+        count += or_equal ? 2 - bits : bits;
+    }
+    for (; i < n; i++) count += or_equal ? keys[i] <= k : keys[i] < k;
+    return count;
+}
+#endif
+
 /**
  * @brief Binary search for a key in a node.
  *
  * Searches for the first position in the node's key array where the key could be inserted.
+ * Numeric trees using the default comparison take a branch-free search with the
+ * comparison inlined; the comparator is only called through its pointer for custom ones.
+ * For signed 64-bit keys the last BPTREE_SIMD_WINDOW keys are counted with SIMD compares.
  *
  * @param tree Pointer to the tree.
  * @param node Pointer to the node.
@@ -980,22 +2186,69 @@ static void bptree_rebalance_up(bptree* tree, bptree_node** node_stack, const in
 static int bptree_node_search(const bptree* tree, const bptree_node* node,
                               const bptree_key_t* key) {
     int low = 0, high = node->num_keys;
-    const bptree_key_t* keys = bptree_node_keys(node);
-    // Adjust behavior for leaf and internal nodes
-    if (node->is_leaf) {
-        while (low < high) {
-            const int mid = low + (high - low) / 2;
-            const int cmp = tree->compare(key, &keys[mid]);
-            if (cmp <= 0) {
-                high = mid;
-            } else {
-                low = mid + 1;
+#ifdef BPTREE_KEY_TYPE_STRING
+    if (tree->compare == bptree_default_compare) return bptree_packed_search(node, key);
+#else
+    if (tree->compare == bptree_default_compare) {
+        if (high == 0) return 0;
+        const bptree_key_t* keys = bptree_node_keys(node);
+        // Narrow [base, base + len] down to one slot; the step is a conditional
+        // move rather than a branch. Leaves want the first key >= key, internal
+        // nodes the first key > key.
+        const bptree_key_t k = *key;
+        const bptree_key_t* base = keys;
+        int len = high;
+#ifdef BPTREE_SIMD_SEARCH
+        // Only signed 64-bit integer keys fit the int64 compares.
+        const int simd_level = __atomic_load_n(&bptree_simd_level, __ATOMIC_RELAXED);
+        if (simd_level > 0 && sizeof(bptree_key_t) == 8 && (bptree_key_t)-1 < 0 &&
+            (bptree_key_t)1 / 2 == 0) {
+            const bool or_equal = !node->is_leaf;
+            while (len > BPTREE_SIMD_WINDOW) {
+                const int half = len / 2;
+                base += (or_equal ? base[half - 1] <= k : base[half - 1] < k) ? half : 0;
+                len -= half;
+            }
+            // Every key before base is below k and every key after base + len is not.
+            const int64_t* window = (const int64_t*)base;
+            const int below = simd_level == 2
+                                  ? bptree_count_below_avx2(window, len, (int64_t)k, or_equal)
+                                  : bptree_count_below_sse42(window, len, (int64_t)k, or_equal);
+            return (int)(base - keys) + below;
+        }
+#endif
+        if (node->is_leaf) {
+            while (len > 1) {
+                const int half = len / 2;
+                base += (base[half - 1] < k) ? half : 0;
+                len -= half;
+            }
+            return (int)(base - keys) + (*base < k);
+        }
+        while (len > 1) {
+            const int half = len / 2;
+            base += (base[half - 1] <= k) ? half : 0;
+            len -= half;
+        }
+        return (int)(base - keys) + (*base <= k);
+    }
+#endif
+    // Adjust behavior for leaf and internal nodes
+    bptree_key_t buf;
+    if (node->is_leaf) {
+        while (low < high) {
+            const int mid = low + (high - low) / 2;
+            const int cmp = tree->compare(key, bptree_node_key(node, mid, &buf));
+            if (cmp <= 0) {
+                high = mid;
+            } else {
+                low = mid + 1;
             }
         }
     } else {
         while (low < high) {
             const int mid = low + (high - low) / 2;
-            const int cmp = tree->compare(key, &keys[mid]);
+            const int cmp = tree->compare(key, bptree_node_key(node, mid, &buf));
             if (cmp < 0) {
                 high = mid;
             } else {
@@ -1006,6 +2259,119 @@ static int bptree_node_search(const bptree* tree, const bptree_node* node,
     return low;
 }
 
+/**
+ * @brief Find the leaf before or after another one by descending from a root.
+ *
+ * Follows the path to @p leaf by its first key, remembering the lowest subtree beside the
+ * path on the wanted side, then walks down that subtree's near edge. This is for when the
+ * leaf chain can't be used: snapshot scans, and finding the leaf whose `next` has to point
+ * at a leaf's copy.
+ *
+ * @param tree Pointer to the tree.
+ * @param root Root of the version to search.
+ * @param leaf A non-empty leaf reachable from @p root, or @p root itself.
+ * @param forward True for the next leaf, false for the previous one.
+ * @return The adjacent leaf, or NULL if @p leaf is the last (or first) one.
+ */
+static bptree_node* bptree_adjacent_leaf(const bptree* tree, const bptree_node* root,
+                                         const bptree_node* leaf, const bool forward) {
+    if (leaf == root) return NULL;
+    bptree_key_t buf;
+    const bptree_key_t* key = bptree_node_key(leaf, 0, &buf);
+    bptree_node* node = (bptree_node*)root;
+    bptree_node* beside = NULL;
+    while (!node->is_leaf) {
+        const int pos = bptree_node_search(tree, node, key);
+        bptree_node** children = bptree_node_children(node, tree->max_keys);
+        if (forward && pos < node->num_keys) beside = children[pos + 1];
+        if (!forward && pos > 0) beside = children[pos - 1];
+        node = children[pos];
+    }
+    if (!beside) return NULL;
+    while (!beside->is_leaf) {
+        beside = bptree_node_children(beside, tree->max_keys)[forward ? 0 : beside->num_keys];
+    }
+    return beside;
+}
+
+/**
+ * @brief Make a node safe to change, copying it if a snapshot may be reading it.
+ *
+ * The copy takes the node's place in its parent (or as the root), and a leaf's copy also
+ * takes its place in the leaf chain. Only the previous leaf's `next` is changed in place,
+ * which snapshots never read. The original is queued for the snapshots.
+ *
+ * @param tree Pointer to the tree.
+ * @param parent Parent of the node, already safe to change, or NULL for the root.
+ * @param pos Index of the node among the parent's children.
+ * @return The node to change, or NULL if the copy could not be allocated.
+ */
+static bptree_node* bptree_cow(bptree* tree, bptree_node* parent, const int pos) {
+    bptree_node** slot = parent ? &bptree_node_children(parent, tree->max_keys)[pos] : &tree->root;
+    bptree_node* node = *slot;
+    if (!bptree_node_shared(tree, node)) return node;
+    bptree_node* copy = bptree_node_copy(tree, node);
+    if (!copy) return NULL;
+    if (node->is_leaf) {
+        bptree_node* prev = bptree_adjacent_leaf(tree, tree->root, node, false);
+        if (prev && prev->next != node) {
+            fprintf(stderr, "[BPTree FATAL] Leaf chain does not match the tree while copying.\n");
+            abort();
+        }
+        if (prev) prev->next = copy;
+    }
+    *slot = copy;
+    bptree_node_discard(tree, node);
+    return copy;
+}
+
+/**
+ * @brief bptree_cow() for rebalancing, which has no way to report a failure.
+ *
+ * @param tree Pointer to the tree.
+ * @param parent Parent of the node, already safe to change.
+ * @param pos Index of the node among the parent's children.
+ * @return The node to change.
+ */
+static bptree_node* bptree_cow_or_abort(bptree* tree, bptree_node* parent, const int pos) {
+    bptree_node* node = bptree_cow(tree, parent, pos);
+    if (!node) {
+        fprintf(stderr, "[BPTree FATAL] Out of memory copying a node while rebalancing.\n");
+        abort();
+    }
+    return node;
+}
+
+/**
+ * @brief Make the root-to-leaf path of a key safe to change.
+ *
+ * Run before a write while snapshots are live, so the write itself can change the nodes on
+ * the path in place. Nodes already copied since the newest snapshot are left alone.
+ *
+ * @param tree Pointer to the tree.
+ * @param key Key whose path the write will change.
+ * @return The leaf for @p key, or NULL if a copy could not be allocated.
+ */
+static bptree_node* bptree_cow_path(bptree* tree, const bptree_key_t* key) {
+    bptree_node* node = bptree_cow(tree, NULL, 0);
+    while (node && !node->is_leaf) {
+        node = bptree_cow(tree, node, bptree_node_search(tree, node, key));
+    }
+    return node;
+}
+
+/**
+ * @brief Find the right-most leaf of the tree.
+ *
+ * @param tree Pointer to the tree.
+ * @return The leaf holding the largest keys.
+ */
+static bptree_node* bptree_rightmost_leaf(const bptree* tree) {
+    bptree_node* node = tree->root;
+    while (!node->is_leaf) node = bptree_node_children(node, tree->max_keys)[node->num_keys];
+    return node;
+}
+
 /**
  * @brief Recursive insertion helper.
  *
@@ -1018,138 +2384,204 @@ static int bptree_node_search(const bptree* tree, const bptree_node* node,
  * @param value Value to insert.
  * @param promoted_key Pointer to store the key to be promoted if a split occurs.
  * @param new_child Pointer to store the new node created from the split.
+ * @param work Search work of the insert, added to as it descends.
  * @return Status code indicating success or failure.
  */
 static bptree_status bptree_insert_internal(bptree* tree, bptree_node* node,
                                             const bptree_key_t* key, const bptree_value_t value,
-                                            bptree_key_t* promoted_key, bptree_node** new_child) {
+                                            bptree_key_t* promoted_key, bptree_node** new_child,
+                                            bptree_search_work* work) {
     const int pos = bptree_node_search(tree, node, key);
+    bptree_search_note(work, node);
     if (node->is_leaf) {
-        bptree_key_t* keys = bptree_node_keys(node);
         bptree_value_t* values = bptree_node_values(node, tree->max_keys);
         // If key exists, report duplicate.
-        if (pos < node->num_keys && tree->compare(key, &keys[pos]) == 0) {
+        if (pos < node->num_keys && bptree_node_key_equals(tree, node, pos, key)) {
             bptree_debug_print(tree->enable_debug, "Insert failed: Duplicate key found.\n");
             return BPTREE_DUPLICATE_KEY;
         }
+        *new_child = NULL;
         // Shift keys and values to make room for the new key/value.
+        if (node->num_keys < tree->max_keys && bptree_keys_insert_at(node, pos, key)) {
+            memmove(&values[pos + 1], &values[pos],
+                    (node->num_keys - pos) * sizeof(bptree_value_t));
+            values[pos] = value;
+            node->num_keys++;
+            bptree_debug_print(tree->enable_debug, "Inserted key in leaf. Node keys: %d\n",
+                               node->num_keys);
+            return BPTREE_OK;
+        }
+        // The leaf is full, or its packed keys have to be rewritten to take this one.
+        bptree_key_t* keys = bptree_keys_open(tree, node);
+        if (!keys) return BPTREE_ALLOCATION_FAILURE;
+        const int total_keys = node->num_keys + 1;
         memmove(&keys[pos + 1], &keys[pos], (node->num_keys - pos) * sizeof(bptree_key_t));
         memmove(&values[pos + 1], &values[pos], (node->num_keys - pos) * sizeof(bptree_value_t));
         keys[pos] = *key;
         values[pos] = value;
-        node->num_keys++;
-        *new_child = NULL;
-        bptree_debug_print(tree->enable_debug, "Inserted key in leaf. Node keys: %d\n",
-                           node->num_keys);
-        // Check for overflow and split if needed.
-        if (node->num_keys > tree->max_keys) {
+        bptree_status status = BPTREE_OK;
+        if (total_keys <= tree->max_keys) {
+            status = bptree_keys_write(tree, node, keys, total_keys);
+            if (status == BPTREE_OK) node->num_keys = total_keys;
+        } else {
+            // Check for overflow and split if needed.
             bptree_debug_print(tree->enable_debug, "Leaf node overflow (%d > %d), splitting.\n",
-                               node->num_keys, tree->max_keys);
-            const int total_keys = node->num_keys;
+                               total_keys, tree->max_keys);
             const int split_idx = (total_keys + 1) / 2;
             const int new_node_keys = total_keys - split_idx;
             bptree_node* new_leaf = bptree_node_alloc(tree, true);
-            if (!new_leaf) {
-                node->num_keys--;
+            status = new_leaf ? bptree_keys_write(tree, new_leaf, &keys[split_idx], new_node_keys)
+                              : BPTREE_ALLOCATION_FAILURE;
+            if (status == BPTREE_OK) status = bptree_keys_write(tree, node, keys, split_idx);
+            if (status == BPTREE_OK) {
+                // Move the latter half values to the new leaf.
+                memcpy(bptree_node_values(new_leaf, tree->max_keys), &values[split_idx],
+                       new_node_keys * sizeof(bptree_value_t));
+                new_leaf->num_keys = new_node_keys;
+                node->num_keys = split_idx;
+                new_leaf->next = node->next;
+                node->next = new_leaf;
+                *promoted_key = bptree_separator(tree, &keys[split_idx - 1], &keys[split_idx]);
+                *new_child = new_leaf;
+                bptree_count(&tree->counters.splits, 1);
+                bptree_debug_print(
+                    tree->enable_debug,
+                    "Leaf split complete. Promoted key. Left keys: %d, Right keys: %d\n",
+                    node->num_keys, new_leaf->num_keys);
+            } else {
+                if (new_leaf) bptree_node_release(new_leaf, tree);
                 bptree_debug_print(tree->enable_debug, "Leaf split allocation failed!\n");
-                return BPTREE_ALLOCATION_FAILURE;
             }
-            bptree_key_t* new_keys = bptree_node_keys(new_leaf);
-            bptree_value_t* new_values = bptree_node_values(new_leaf, tree->max_keys);
-            // Move the latter half keys/values to the new leaf.
-            memcpy(new_keys, &keys[split_idx], new_node_keys * sizeof(bptree_key_t));
-            memcpy(new_values, &values[split_idx], new_node_keys * sizeof(bptree_value_t));
-            new_leaf->num_keys = new_node_keys;
-            node->num_keys = split_idx;
-            new_leaf->next = node->next;
-            node->next = new_leaf;
-            *promoted_key = new_keys[0];
-            *new_child = new_leaf;
-            bptree_debug_print(tree->enable_debug,
-                               "Leaf split complete. Promoted key. Left keys: %d, Right keys: %d\n",
-                               node->num_keys, new_leaf->num_keys);
         }
-        return BPTREE_OK;
+        if (status != BPTREE_OK) {
+            // Put the node back as it was.
+            memmove(&keys[pos], &keys[pos + 1], (total_keys - pos - 1) * sizeof(bptree_key_t));
+            memmove(&values[pos], &values[pos + 1],
+                    (total_keys - pos - 1) * sizeof(bptree_value_t));
+        }
+        bptree_keys_close(keys);
+        return status;
     } else {
         // Recurse into the appropriate child.
         bptree_node** children = bptree_node_children(node, tree->max_keys);
         bptree_key_t child_promoted_key;
         bptree_node* child_new_node = NULL;
-        const bptree_status status = bptree_insert_internal(tree, children[pos], key, value,
-                                                            &child_promoted_key, &child_new_node);
+        bptree_status status = bptree_insert_internal(tree, children[pos], key, value,
+                                                      &child_promoted_key, &child_new_node, work);
         if (status != BPTREE_OK || child_new_node == NULL) {
             return status;
         }
         bptree_debug_print(tree->enable_debug,
                            "Child split propagated. Inserting promoted key into internal node.\n");
-        bptree_key_t* keys = bptree_node_keys(node);
+        *new_child = NULL;
         // Shift parent's keys and child pointers to insert the promoted key.
+        if (node->num_keys < tree->max_keys &&
+            bptree_keys_insert_at(node, pos, &child_promoted_key)) {
+            memmove(&children[pos + 2], &children[pos + 1],
+                    (node->num_keys - pos) * sizeof(bptree_node*));
+            children[pos + 1] = child_new_node;
+            node->num_keys++;
+            bptree_debug_print(tree->enable_debug, "Internal node keys: %d\n", node->num_keys);
+            return BPTREE_OK;
+        }
+        bptree_key_t* keys = bptree_keys_open(tree, node);
+        if (!keys) return BPTREE_ALLOCATION_FAILURE;
+        const int total_keys = node->num_keys + 1;
         memmove(&keys[pos + 1], &keys[pos], (node->num_keys - pos) * sizeof(bptree_key_t));
         memmove(&children[pos + 2], &children[pos + 1],
                 (node->num_keys - pos) * sizeof(bptree_node*));
         keys[pos] = child_promoted_key;
         children[pos + 1] = child_new_node;
-        node->num_keys++;
-        bptree_debug_print(tree->enable_debug, "Internal node keys: %d\n", node->num_keys);
-        // Split internal node if it exceeds capacity.
-        if (node->num_keys > tree->max_keys) {
+        if (total_keys <= tree->max_keys) {
+            status = bptree_keys_write(tree, node, keys, total_keys);
+            if (status == BPTREE_OK) node->num_keys = total_keys;
+        } else {
+            // Split internal node if it exceeds capacity.
             bptree_debug_print(tree->enable_debug, "Internal node overflow (%d > %d), splitting.\n",
-                               node->num_keys, tree->max_keys);
-            const int total_keys = node->num_keys;
+                               total_keys, tree->max_keys);
             const int split_idx = total_keys / 2;
             const int new_node_keys = total_keys - split_idx - 1;
             bptree_node* new_internal = bptree_node_alloc(tree, false);
-            if (!new_internal) {
-                node->num_keys--;
+            status = new_internal ? bptree_keys_write(tree, new_internal, &keys[split_idx + 1],
+                                                      new_node_keys)
+                                  : BPTREE_ALLOCATION_FAILURE;
+            if (status == BPTREE_OK) status = bptree_keys_write(tree, node, keys, split_idx);
+            if (status == BPTREE_OK) {
+                *promoted_key = keys[split_idx];
+                *new_child = new_internal;
+                memcpy(bptree_node_children(new_internal, tree->max_keys), &children[split_idx + 1],
+                       (new_node_keys + 1) * sizeof(bptree_node*));
+                new_internal->num_keys = new_node_keys;
+                node->num_keys = split_idx;
+                bptree_count(&tree->counters.splits, 1);
+                bptree_debug_print(
+                    tree->enable_debug,
+                    "Internal split complete. Promoted key. Left keys: %d, Right keys: %d\n",
+                    node->num_keys, new_internal->num_keys);
+            } else {
+                if (new_internal) bptree_node_release(new_internal, tree);
                 bptree_debug_print(tree->enable_debug, "Internal split allocation failed!\n");
-                return BPTREE_ALLOCATION_FAILURE;
             }
-            bptree_key_t* new_keys = bptree_node_keys(new_internal);
-            bptree_node** new_children = bptree_node_children(new_internal, tree->max_keys);
-            *promoted_key = keys[split_idx];
-            *new_child = new_internal;
-            memcpy(new_keys, &keys[split_idx + 1], new_node_keys * sizeof(bptree_key_t));
-            memcpy(new_children, &children[split_idx + 1],
-                   (new_node_keys + 1) * sizeof(bptree_node*));
-            new_internal->num_keys = new_node_keys;
-            node->num_keys = split_idx;
-            bptree_debug_print(
-                tree->enable_debug,
-                "Internal split complete. Promoted key. Left keys: %d, Right keys: %d\n",
-                node->num_keys, new_internal->num_keys);
-        } else {
-            *new_child = NULL;
         }
-        return BPTREE_OK;
+        if (status != BPTREE_OK) {
+            memmove(&keys[pos], &keys[pos + 1], (total_keys - pos - 1) * sizeof(bptree_key_t));
+            memmove(&children[pos + 1], &children[pos + 2],
+                    (total_keys - pos - 1) * sizeof(bptree_node*));
+        }
+        bptree_keys_close(keys);
+        return status;
     }
 }
 
+/**
+ * @brief Put a new root above a root that just split.
+ *
+ * @param tree Pointer to the tree.
+ * @param promoted_key Separator returned by the split.
+ * @param new_node Right half returned by the split.
+ * @return BPTREE_OK, or BPTREE_ALLOCATION_FAILURE if the new root could not be allocated.
+ */
+static bptree_status bptree_grow_root(bptree* tree, const bptree_key_t promoted_key,
+                                      bptree_node* new_node) {
+    bptree_debug_print(tree->enable_debug, "Root split occurred. Creating new root.\n");
+    bptree_node* new_root = bptree_node_alloc(tree, false);
+    if (!new_root) {
+        bptree_free_node(new_node, tree);
+        return BPTREE_ALLOCATION_FAILURE;
+    }
+    if (bptree_keys_write(tree, new_root, &promoted_key, 1) != BPTREE_OK) {
+        bptree_node_release(new_root, tree);
+        bptree_free_node(new_node, tree);
+        return BPTREE_ALLOCATION_FAILURE;
+    }
+    bptree_node** root_children = bptree_node_children(new_root, tree->max_keys);
+    root_children[0] = tree->root;
+    root_children[1] = new_node;
+    new_root->num_keys = 1;
+    // Release so concurrent readers that load the new root see it filled in.
+    __atomic_store_n(&tree->root, new_root, __ATOMIC_RELEASE);
+    tree->height++;
+    bptree_debug_print(tree->enable_debug, "New root created. Tree height: %d\n", tree->height);
+    return BPTREE_OK;
+}
+
 BPTREE_API bptree_status bptree_put(bptree* tree, const bptree_key_t* key, bptree_value_t value) {
     if (!tree || !key) return BPTREE_INVALID_ARGUMENT;
     if (!tree->root) return BPTREE_INTERNAL_ERROR;
+    bptree_reclaim(tree);
+    // With snapshots live, copy the path first so the insert can change it in place.
+    if (tree->snapshot_gen != 0 && !bptree_cow_path(tree, key)) return BPTREE_ALLOCATION_FAILURE;
     bptree_key_t promoted_key;
     bptree_node* new_node = NULL;
-    const bptree_status status =
-        bptree_insert_internal(tree, tree->root, key, value, &promoted_key, &new_node);
+    bptree_search_work work = {1, 0, 0};
+    bptree_status status =
+        bptree_insert_internal(tree, tree->root, key, value, &promoted_key, &new_node, &work);
+    bptree_search_flush(tree, &work);
     if (status == BPTREE_OK) {
         // If a split occurred at the root, create a new root.
         if (new_node != NULL) {
-            bptree_debug_print(tree->enable_debug, "Root split occurred. Creating new root.\n");
-            bptree_node* new_root = bptree_node_alloc(tree, false);
-            if (!new_root) {
-                bptree_free_node(new_node, tree);
-                return BPTREE_ALLOCATION_FAILURE;
-            }
-            bptree_key_t* root_keys = bptree_node_keys(new_root);
-            bptree_node** root_children = bptree_node_children(new_root, tree->max_keys);
-            root_keys[0] = promoted_key;
-            root_children[0] = tree->root;
-            root_children[1] = new_node;
-            new_root->num_keys = 1;
-            tree->root = new_root;
-            tree->height++;
-            bptree_debug_print(tree->enable_debug, "New root created. Tree height: %d\n",
-                               tree->height);
+            status = bptree_grow_root(tree, promoted_key, new_node);
+            if (status != BPTREE_OK) return status;
         }
         tree->count++;
     } else {
@@ -1159,40 +2591,62 @@ BPTREE_API bptree_status bptree_put(bptree* tree, const bptree_key_t* key, bptre
     return status;
 }
 
-BPTREE_API bptree_status bptree_get(const bptree* tree, const bptree_key_t* key,
-                                    bptree_value_t* out_value) {
-    if (!tree || !tree->root || !key || !out_value) return BPTREE_INVALID_ARGUMENT;
-    if (tree->count == 0) return BPTREE_KEY_NOT_FOUND;
-    bptree_node* node = tree->root;
+/**
+ * @brief Look a key up in the version of the tree under a root.
+ *
+ * @param tree Pointer to the tree.
+ * @param root The tree's root, or a snapshot's.
+ * @param key Pointer to the key to search.
+ * @param out_value Pointer to store the found value.
+ * @return BPTREE_OK if found, otherwise BPTREE_KEY_NOT_FOUND.
+ */
+static bptree_status bptree_get_from(const bptree* tree, const bptree_node* root,
+                                     const bptree_key_t* key, bptree_value_t* out_value) {
+    bptree_node* node = (bptree_node*)root;
+    bptree_search_work work = {1, 0, 0};
     // Traverse the tree until a leaf is reached.
     while (!node->is_leaf) {
         const int pos = bptree_node_search(tree, node, key);
+        bptree_search_note(&work, node);
         node = bptree_node_children(node, tree->max_keys)[pos];
         if (!node) return BPTREE_INTERNAL_ERROR;
     }
     int pos = bptree_node_search(tree, node, key);
-    const bptree_key_t* keys = bptree_node_keys(node);
-    if (pos < node->num_keys && tree->compare(key, &keys[pos]) == 0) {
+    bptree_search_note(&work, node);
+    bptree_search_flush(tree, &work);
+    if (pos < node->num_keys && bptree_node_key_equals(tree, node, pos, key)) {
         *out_value = bptree_node_values(node, tree->max_keys)[pos];
         return BPTREE_OK;
     }
     return BPTREE_KEY_NOT_FOUND;
 }
 
+BPTREE_API bptree_status bptree_get(const bptree* tree, const bptree_key_t* key,
+                                    bptree_value_t* out_value) {
+    if (!tree || !tree->root || !key || !out_value) return BPTREE_INVALID_ARGUMENT;
+    if (tree->count == 0) return BPTREE_KEY_NOT_FOUND;
+    return bptree_get_from(tree, tree->root, key, out_value);
+}
+
 BPTREE_API bptree_status bptree_remove(bptree* tree, const bptree_key_t* key) {
 #define BPTREE_MAX_HEIGHT_REMOVE 64
     bptree_node* node_stack[BPTREE_MAX_HEIGHT_REMOVE];
     int index_stack[BPTREE_MAX_HEIGHT_REMOVE];
     int depth = 0;
     if (!tree || !tree->root || !key) return BPTREE_INVALID_ARGUMENT;
+    bptree_reclaim(tree);
     if (tree->count == 0) return BPTREE_KEY_NOT_FOUND;
+    // With snapshots live, copy the path first; a rebalance copies the siblings it changes.
+    if (tree->snapshot_gen != 0 && !bptree_cow_path(tree, key)) return BPTREE_ALLOCATION_FAILURE;
     bptree_node* node = tree->root;
+    bptree_search_work work = {1, 0, 0};
     // Traverse down the tree and record the path (nodes and child indexes)
     while (!node->is_leaf) {
         if (depth >= BPTREE_MAX_HEIGHT_REMOVE) {
             return BPTREE_INTERNAL_ERROR;
         }
         const int pos = bptree_node_search(tree, node, key);
+        bptree_search_note(&work, node);
         node_stack[depth] = node;
         index_stack[depth] = pos;
         depth++;
@@ -1200,15 +2654,17 @@ BPTREE_API bptree_status bptree_remove(bptree* tree, const bptree_key_t* key) {
         if (!node) return BPTREE_INTERNAL_ERROR;
     }
     const int pos = bptree_node_search(tree, node, key);
-    bptree_key_t* keys = bptree_node_keys(node);
-    if (pos >= node->num_keys || tree->compare(key, &keys[pos]) != 0) {
+    bptree_search_note(&work, node);
+    bptree_search_flush(tree, &work);
+    if (pos >= node->num_keys || !bptree_node_key_equals(tree, node, pos, key)) {
         return BPTREE_KEY_NOT_FOUND;
     }
     // Save the key being deleted for potential parent updates.
-    const bptree_key_t deleted_key_copy = keys[pos];
+    bptree_key_t buf;
+    const bptree_key_t deleted_key_copy = *bptree_node_key(node, pos, &buf);
     bptree_value_t* values = bptree_node_values(node, tree->max_keys);
     // Remove key and value by shifting remaining entries left.
-    memmove(&keys[pos], &keys[pos + 1], (node->num_keys - pos - 1) * sizeof(bptree_key_t));
+    bptree_keys_remove_at(node, pos);
     memmove(&values[pos], &values[pos + 1], (node->num_keys - pos - 1) * sizeof(bptree_value_t));
     node->num_keys--;
     tree->count--;
@@ -1223,14 +2679,17 @@ BPTREE_API bptree_status bptree_remove(bptree* tree, const bptree_key_t* key) {
             const int parent_child_idx = index_stack[d];
             if (parent_child_idx > 0) {
                 bptree_node* parent = node_stack[d];
-                bptree_key_t* parent_keys = bptree_node_keys(parent);
                 const int separator_idx = parent_child_idx - 1;
+                bptree_key_t separator;
                 if (separator_idx < parent->num_keys &&
-                    tree->compare(&parent_keys[separator_idx], &deleted_key_copy) == 0) {
+                    bptree_compare_keys(tree, bptree_node_key(parent, separator_idx, &separator),
+                                        &deleted_key_copy) == 0) {
                     bptree_debug_print(tree->enable_debug,
                                        "Updating ancestor separator key [%d] at depth %d.\n",
                                        separator_idx, d);
-                    parent_keys[separator_idx] = keys[0];
+                    bptree_key_t* parent_keys = bptree_keys_open_or_abort(tree, parent);
+                    parent_keys[separator_idx] = *bptree_node_key(node, 0, &buf);
+                    bptree_keys_finish(tree, parent, parent_keys, parent->num_keys);
                     break;  // Found and updated the key, no need to go higher.
                 }
             }
@@ -1251,88 +2710,408 @@ BPTREE_API bptree_status bptree_remove(bptree* tree, const bptree_key_t* key) {
     return BPTREE_OK;
 }
 
-BPTREE_API bptree_status bptree_get_range(const bptree* tree, const bptree_key_t* start,
-                                          const bptree_key_t* end, bptree_value_t** out_values,
-                                          int* n_results) {
-    if (!tree || !tree->root || !start || !end || !out_values || !n_results) {
-        return BPTREE_INVALID_ARGUMENT;
+/**
+ * @brief Sort a batch by key without moving it.
+ *
+ * Bottom-up merge sort of an index permutation, so keys and values stay where the caller
+ * put them and equal keys keep their batch order.
+ *
+ * @param tree Pointer to the tree (for the comparison).
+ * @param keys Keys to sort by.
+ * @param order Permutation to sort, n entries.
+ * @param scratch Scratch space, n entries.
+ * @param n Number of keys.
+ */
+static void bptree_batch_sort(const bptree* tree, const bptree_key_t* keys, int* order,
+                              int* scratch, const int n) {
+    for (int width = 1; width < n; width *= 2) {
+        for (int lo = 0; lo < n; lo += 2 * width) {
+            const int mid = (lo + width < n) ? lo + width : n;
+            const int hi = (lo + 2 * width < n) ? lo + 2 * width : n;
+            int a = lo, b = mid, out = lo;
+            while (a < mid && b < hi) {
+                scratch[out++] = bptree_compare_keys(tree, &keys[order[b]], &keys[order[a]]) < 0
+                                     ? order[b++]
+                                     : order[a++];
+            }
+            while (a < mid) scratch[out++] = order[a++];
+            while (b < hi) scratch[out++] = order[b++];
+        }
+        memcpy(order, scratch, (size_t)n * sizeof(int));
     }
-    *out_values = NULL;
-    *n_results = 0;
-    if (tree->compare(start, end) > 0) {
+}
+
+BPTREE_API bptree_status bptree_put_batch(bptree* tree, const bptree_key_t* keys,
+                                          const bptree_value_t* values, const int n,
+                                          int* n_inserted) {
+    if (n_inserted) *n_inserted = 0;
+    if (!tree || !tree->root || n < 0 || (n > 0 && (!keys || !values))) {
         return BPTREE_INVALID_ARGUMENT;
     }
-    if (tree->count == 0) {
-        return BPTREE_OK;
-    }
-    bptree_node* node = tree->root;
-    // Locate the starting leaf node.
-    while (!node->is_leaf) {
-        const int pos = bptree_node_search(tree, node, start);
-        node = bptree_node_children(node, tree->max_keys)[pos];
-        if (!node) return BPTREE_INTERNAL_ERROR;
+    int* order = NULL;
+    for (int i = 1; i < n; i++) {
+        if (bptree_compare_keys(tree, &keys[i - 1], &keys[i]) > 0) {
+            order = malloc((size_t)n * 2 * sizeof(int));
+            if (!order) return BPTREE_ALLOCATION_FAILURE;
+            for (int j = 0; j < n; j++) order[j] = j;
+            bptree_batch_sort(tree, keys, order, order + n, n);
+            break;
+        }
     }
-    int count = 0;
-    bptree_node* current_node = node;
-    bool past_end = false;
-    // Count how many keys fall within the range.
-    while (current_node && !past_end) {
-        const bptree_key_t* keys = bptree_node_keys(current_node);
-        for (int i = 0; i < current_node->num_keys; i++) {
-            if (tree->compare(&keys[i], start) >= 0) {
-                if (tree->compare(&keys[i], end) <= 0) {
-                    count++;
-                } else {
-                    past_end = true;
-                    break;
-                }
+    bptree_reclaim(tree);
+    bptree_status status = BPTREE_OK;
+    int inserted = 0;
+    bptree_search_work work = {0, 0, 0};
+    bptree_node* rightmost = bptree_rightmost_leaf(tree);
+    int i = 0;
+    while (i < n && status == BPTREE_OK) {
+        int at = order ? order[i] : i;
+        // Find the leaf for keys[at] and the separator that ends its key range.
+        bptree_node* leaf = rightmost;
+        const bptree_key_t* bound = NULL;
+        bptree_key_t bound_buf, last_buf;
+        if (rightmost->num_keys == 0
+                ? tree->count != 0
+                : bptree_compare_keys(tree, &keys[at],
+                                      bptree_node_key(rightmost, rightmost->num_keys - 1,
+                                                      &last_buf)) <= 0) {
+            leaf = tree->root;
+            work.descents++;
+            while (!leaf->is_leaf) {
+                const int pos = bptree_node_search(tree, leaf, &keys[at]);
+                bptree_search_note(&work, leaf);
+                if (pos < leaf->num_keys) bound = bptree_node_key(leaf, pos, &bound_buf);
+                leaf = bptree_node_children(leaf, tree->max_keys)[pos];
             }
         }
-        if (!past_end) {
-            current_node = current_node->next;
+        // A leaf a snapshot can see is copied, with its path, before the run goes in.
+        if (bptree_node_shared(tree, leaf)) {
+            const bool was_rightmost = leaf == rightmost;
+            leaf = bptree_cow_path(tree, &keys[at]);
+            if (!leaf) {
+                status = BPTREE_ALLOCATION_FAILURE;
+                break;
+            }
+            if (was_rightmost) rightmost = leaf;
+        }
+        // Insert the run of keys below the bound while the leaf has room.
+        bptree_value_t* leaf_values = bptree_node_values(leaf, tree->max_keys);
+        bool leaf_full = false;
+        for (; i < n; i++) {
+            at = order ? order[i] : i;
+            if (bound && bptree_compare_keys(tree, &keys[at], bound) >= 0) break;
+            const int num_keys = leaf->num_keys;
+            int pos = num_keys;
+            if (num_keys > 0 &&
+                bptree_compare_keys(tree, &keys[at],
+                                    bptree_node_key(leaf, num_keys - 1, &last_buf)) <= 0) {
+                pos = bptree_node_search(tree, leaf, &keys[at]);
+                bptree_search_note(&work, leaf);
+                if (bptree_node_key_equals(tree, leaf, pos, &keys[at])) continue;
+            }
+            // Packed keys that don't fit as they are go through a regular put too.
+            if (num_keys >= tree->max_keys || !bptree_keys_insert_at(leaf, pos, &keys[at])) {
+                leaf_full = true;
+                break;
+            }
+            memmove(&leaf_values[pos + 1], &leaf_values[pos],
+                    (num_keys - pos) * sizeof(bptree_value_t));
+            leaf_values[pos] = values[at];
+            leaf->num_keys++;
+            tree->count++;
+            inserted++;
+        }
+        // The next key overflows this leaf: a regular put splits it (or repacks it).
+        if (leaf_full) {
+            status = bptree_put(tree, &keys[at], values[at]);
+            if (status == BPTREE_OK) inserted++;
+            // The put may have split the right-most leaf, or copied it for a snapshot.
+            rightmost = bptree_rightmost_leaf(tree);
+            i++;
         }
     }
-    if (count == 0) {
-        return BPTREE_OK;
+    bptree_search_flush(tree, &work);
+    free(order);
+    if (n_inserted) *n_inserted = inserted;
+    bptree_debug_print(tree->enable_debug, "Batch put: %d of %d pairs inserted\n", inserted, n);
+    return status;
+}
+
+/**
+ * @brief Decide how many nodes one level of a bulk load needs.
+ *
+ * The entries are later spread evenly over the nodes, so the count is chosen such that
+ * no node falls below the minimum occupancy or above the maximum.
+ *
+ * @param total Number of entries at this level.
+ * @param target Entries per node requested by the fill factor.
+ * @param min_per_node Minimum entries a non-root node may hold.
+ * @param n_nodes Pointer to store the number of nodes needed.
+ */
+static void bptree_bulk_level_shape(const int total, const int target, const int min_per_node,
+                                    int* n_nodes) {
+    int nodes = (total + target - 1) / target;
+    // Fewer, fuller nodes if an even split would leave them under the minimum.
+    if (nodes > 1 && total / nodes < min_per_node) {
+        nodes = total / min_per_node;
+    }
+    *n_nodes = nodes > 0 ? nodes : 1;
+}
+
+BPTREE_API bptree_status bptree_bulk_load(bptree* tree, const bptree_key_t* keys,
+                                          const bptree_value_t* values, const int n,
+                                          const double fill_factor) {
+    if (!tree || !tree->root || n < 0 || (n > 0 && (!keys || !values))) {
+        return BPTREE_INVALID_ARGUMENT;
     }
-    const size_t alloc_size = (size_t)count * sizeof(bptree_value_t);
-    *out_values = malloc(alloc_size);
-    if (!*out_values) {
+    bptree_reclaim(tree);
+    if (tree->count != 0 || tree->snapshot_gen != 0 || !(fill_factor > 0.0 && fill_factor <= 1.0)) {
+        return BPTREE_INVALID_ARGUMENT;
+    }
+    for (int i = 1; i < n; i++) {
+        if (bptree_compare_keys(tree, &keys[i - 1], &keys[i]) >= 0) {
+            bptree_debug_print(tree->enable_debug, "Bulk load failed: keys not sorted at %d\n", i);
+            return BPTREE_INVALID_ARGUMENT;
+        }
+    }
+    if (n == 0) return BPTREE_OK;
+
+    int leaf_target = (int)(tree->max_keys * fill_factor);
+    if (leaf_target < tree->min_leaf_keys) leaf_target = tree->min_leaf_keys;
+    if (leaf_target > tree->max_keys) leaf_target = tree->max_keys;
+    int n_leaves;
+    bptree_bulk_level_shape(n, leaf_target, tree->min_leaf_keys, &n_leaves);
+
+    bptree_node** level = malloc((size_t)n_leaves * sizeof(bptree_node*));
+    bptree_key_t* level_min = malloc((size_t)n_leaves * sizeof(bptree_key_t));
+    if (!level || !level_min) {
+        free(level);
+        free(level_min);
         return BPTREE_ALLOCATION_FAILURE;
     }
-    int index = 0;
-    current_node = node;
-    past_end = false;
-    // Populate the output array with values within the key range.
-    while (current_node && !past_end && index < count) {
-        const bptree_key_t* keys = bptree_node_keys(current_node);
-        const bptree_value_t* values = bptree_node_values(current_node, tree->max_keys);
-        for (int i = 0; i < current_node->num_keys; i++) {
-            if (tree->compare(&keys[i], start) >= 0) {
-                if (tree->compare(&keys[i], end) <= 0) {
-                    if (index < count) {
-                        (*out_values)[index++] = values[i];
-                    } else {
-                        bptree_debug_print(tree->enable_debug,
-                                           "Range Error: Exceeded count during collection.\n");
-                        past_end = true;
-                        break;
-                    }
-                } else {
-                    past_end = true;
-                    break;
-                }
-            }
+    // Build the leaf level, spreading the remainder over the first leaves.
+    int consumed = 0;
+    for (int i = 0; i < n_leaves; i++) {
+        const int take = n / n_leaves + (i < n % n_leaves ? 1 : 0);
+        bptree_node* leaf = bptree_node_alloc(tree, true);
+        if (!leaf) {
+            for (int j = 0; j < i; j++) bptree_node_release(level[j], tree);
+            free(level);
+            free(level_min);
+            return BPTREE_ALLOCATION_FAILURE;
+        }
+        if (bptree_keys_write(tree, leaf, &keys[consumed], take) != BPTREE_OK) {
+            bptree_node_release(leaf, tree);
+            for (int j = 0; j < i; j++) bptree_node_release(level[j], tree);
+            free(level);
+            free(level_min);
+            return BPTREE_ALLOCATION_FAILURE;
         }
-        if (!past_end) {
-            current_node = current_node->next;
+        memcpy(bptree_node_values(leaf, tree->max_keys), &values[consumed],
+               (size_t)take * sizeof(bptree_value_t));
+        leaf->num_keys = take;
+        if (i > 0) level[i - 1]->next = leaf;
+        level[i] = leaf;
+        level_min[i] = keys[consumed];
+        consumed += take;
+    }
+    bptree_debug_print(tree->enable_debug, "Bulk load: %d leaves for %d keys\n", n_leaves, n);
+
+    // Build internal levels until a single node remains. Children per node are
+    // bounded by max_keys + 1 and min_internal_keys + 1.
+    int height = 1;
+    int level_size = n_leaves;
+    int child_target = (int)((tree->max_keys + 1) * fill_factor);
+    if (child_target < tree->min_internal_keys + 1) child_target = tree->min_internal_keys + 1;
+    if (child_target > tree->max_keys + 1) child_target = tree->max_keys + 1;
+    while (level_size > 1) {
+        int n_parents;
+        bptree_bulk_level_shape(level_size, child_target, tree->min_internal_keys + 1, &n_parents);
+        bptree_node** parents = malloc((size_t)n_parents * sizeof(bptree_node*));
+        bptree_key_t* parents_min = malloc((size_t)n_parents * sizeof(bptree_key_t));
+        if (!parents || !parents_min) {
+            free(parents);
+            free(parents_min);
+            for (int j = 0; j < level_size; j++) bptree_free_node(level[j], tree);
+            free(level);
+            free(level_min);
+            return BPTREE_ALLOCATION_FAILURE;
+        }
+        int child = 0;
+        for (int i = 0; i < n_parents; i++) {
+            const int take = level_size / n_parents + (i < level_size % n_parents ? 1 : 0);
+            bptree_node* parent = bptree_node_alloc(tree, false);
+            if (!parent) {
+                for (int j = 0; j < i; j++) bptree_node_release(parents[j], tree);
+                for (int j = 0; j < level_size; j++) bptree_free_node(level[j], tree);
+                free(parents);
+                free(parents_min);
+                free(level);
+                free(level_min);
+                return BPTREE_ALLOCATION_FAILURE;
+            }
+            bptree_node** parent_children = bptree_node_children(parent, tree->max_keys);
+            for (int c = 0; c < take; c++) parent_children[c] = level[child + c];
+            // Separator c-1 is the smallest key under child c.
+            if (bptree_keys_write(tree, parent, &level_min[child + 1], take - 1) != BPTREE_OK) {
+                bptree_node_release(parent, tree);
+                for (int j = 0; j < i; j++) bptree_node_release(parents[j], tree);
+                for (int j = 0; j < level_size; j++) bptree_free_node(level[j], tree);
+                free(parents);
+                free(parents_min);
+                free(level);
+                free(level_min);
+                return BPTREE_ALLOCATION_FAILURE;
+            }
+            parent->num_keys = take - 1;
+            parents[i] = parent;
+            parents_min[i] = level_min[child];
+            child += take;
         }
+        free(level);
+        free(level_min);
+        level = parents;
+        level_min = parents_min;
+        level_size = n_parents;
+        height++;
+    }
+
+    bptree_node_release(tree->root, tree);
+    tree->root = level[0];
+    tree->height = height;
+    tree->count = n;
+    free(level);
+    free(level_min);
+    bptree_debug_print(tree->enable_debug, "Bulk load complete. Height: %d\n", height);
+    return BPTREE_OK;
+}
+
+/**
+ * @brief The leaf after the one a cursor is on.
+ *
+ * A snapshot's leaves can't be chained through `next`, which writers relink for the live
+ * tree, so snapshot cursors find the next leaf from the snapshot's root instead.
+ *
+ * @param cursor Cursor being advanced.
+ * @param leaf Leaf the cursor is done with.
+ * @return The next leaf, or NULL after the last one.
+ */
+static const bptree_node* bptree_cursor_next_leaf(const bptree_cursor* cursor,
+                                                  const bptree_node* leaf) {
+    if (!cursor->root) return leaf->next;
+    return bptree_adjacent_leaf(cursor->tree, cursor->root, leaf, true);
+}
+
+/**
+ * @brief Position a cursor in the tree or in a snapshot.
+ *
+ * @param tree Pointer to the tree.
+ * @param snapshot_root Root of the snapshot to scan, or NULL to scan the tree.
+ * @param start First key of the range, or NULL to start at the smallest key.
+ * @param end Last key of the range (inclusive), or NULL to scan to the largest key.
+ * @param cursor Cursor to initialize.
+ * @return BPTREE_OK if successful, BPTREE_INVALID_ARGUMENT if start > end.
+ */
+static bptree_status bptree_cursor_start(const bptree* tree, const bptree_node* snapshot_root,
+                                         const bptree_key_t* start, const bptree_key_t* end,
+                                         bptree_cursor* cursor) {
+    if (start && end && bptree_compare_keys(tree, start, end) > 0) {
+        return BPTREE_INVALID_ARGUMENT;
+    }
+    cursor->tree = tree;
+    cursor->root = snapshot_root;
+    cursor->has_end = end != NULL;
+    if (end) cursor->end = *end;
+    const bptree_node* node = snapshot_root ? snapshot_root : tree->root;
+    bptree_search_work work = {1, 0, 0};
+    // Locate the leaf that holds start, or the leftmost leaf.
+    while (!node->is_leaf) {
+        const int pos = start ? bptree_node_search(tree, node, start) : 0;
+        if (start) bptree_search_note(&work, node);
+        node = bptree_node_children((bptree_node*)node, tree->max_keys)[pos];
+        if (!node) return BPTREE_INTERNAL_ERROR;
+    }
+    int pos = start ? bptree_node_search(tree, node, start) : 0;
+    if (start) bptree_search_note(&work, node);
+    bptree_search_flush(tree, &work);
+    // start may be above every key in its leaf; the first pair is then in the next one.
+    while (node && pos >= node->num_keys) {
+        node = bptree_cursor_next_leaf(cursor, node);
+        pos = 0;
+    }
+    cursor->leaf = node;
+    cursor->pos = pos;
+    return BPTREE_OK;
+}
+
+BPTREE_API bptree_status bptree_cursor_seek(const bptree* tree, const bptree_key_t* start,
+                                            const bptree_key_t* end, bptree_cursor* cursor) {
+    if (!tree || !tree->root || !cursor) return BPTREE_INVALID_ARGUMENT;
+    return bptree_cursor_start(tree, NULL, start, end, cursor);
+}
+
+BPTREE_API bptree_status bptree_cursor_next(bptree_cursor* cursor, bptree_key_t* out_key,
+                                            bptree_value_t* out_value) {
+    if (!cursor) return BPTREE_INVALID_ARGUMENT;
+    const bptree_node* leaf = cursor->leaf;
+    if (!leaf) return BPTREE_KEY_NOT_FOUND;
+    const bptree* tree = cursor->tree;
+    bptree_key_t buf;
+    const bptree_key_t* key = bptree_node_key(leaf, cursor->pos, &buf);
+    // Keys only grow along the chain, so only the end bound needs checking.
+    if (cursor->has_end && bptree_compare_keys(tree, key, &cursor->end) > 0) {
+        cursor->leaf = NULL;
+        return BPTREE_KEY_NOT_FOUND;
+    }
+    if (out_key) *out_key = *key;
+    if (out_value) {
+        *out_value = bptree_node_values((bptree_node*)leaf, tree->max_keys)[cursor->pos];
+    }
+    cursor->pos++;
+    while (leaf && cursor->pos >= leaf->num_keys) {
+        leaf = bptree_cursor_next_leaf(cursor, leaf);
+        cursor->pos = 0;
+    }
+    cursor->leaf = leaf;
+    return BPTREE_OK;
+}
+
+BPTREE_API void bptree_cursor_close(bptree_cursor* cursor) {
+    if (cursor) cursor->leaf = NULL;
+}
+
+BPTREE_API bptree_status bptree_get_range(const bptree* tree, const bptree_key_t* start,
+                                          const bptree_key_t* end, bptree_value_t** out_values,
+                                          int* n_results) {
+    if (!tree || !tree->root || !start || !end || !out_values || !n_results) {
+        return BPTREE_INVALID_ARGUMENT;
     }
-    *n_results = index;
-    if (index != count) {
-        bptree_debug_print(tree->enable_debug, "Range Warning: Final index %d != counted %d\n",
-                           index, count);
+    *out_values = NULL;
+    *n_results = 0;
+    bptree_cursor cursor;
+    const bptree_status status = bptree_cursor_seek(tree, start, end, &cursor);
+    if (status != BPTREE_OK) {
+        return status;
     }
+    // One pass over the leaf chain, growing the output as it fills.
+    int count = 0;
+    int capacity = 0;
+    bptree_value_t value;
+    while (bptree_cursor_next(&cursor, NULL, &value) == BPTREE_OK) {
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            bptree_value_t* grown = realloc(*out_values, (size_t)capacity * sizeof(bptree_value_t));
+            if (!grown) {
+                free(*out_values);
+                *out_values = NULL;
+                return BPTREE_ALLOCATION_FAILURE;
+            }
+            *out_values = grown;
+        }
+        (*out_values)[count++] = value;
+    }
+    bptree_cursor_close(&cursor);
+    *n_results = count;
     return BPTREE_OK;
 }
 
@@ -1341,13 +3120,29 @@ BPTREE_API void bptree_free_range_results(bptree_value_t* results) { free(result
 BPTREE_API bptree_stats bptree_get_stats(const bptree* tree) {
     bptree_stats stats;
     if (!tree) {
-        stats.count = 0;
-        stats.height = 0;
-        stats.node_count = 0;
+        memset(&stats, 0, sizeof(stats));
     } else {
         stats.count = tree->count;
         stats.height = tree->height;
-        stats.node_count = bptree_count_nodes(tree->root, tree);
+        stats.leaf_count = __atomic_load_n(&tree->leaf_nodes, __ATOMIC_RELAXED);
+        stats.internal_count = __atomic_load_n(&tree->internal_nodes, __ATOMIC_RELAXED);
+        stats.node_count = stats.leaf_count + stats.internal_count;
+        stats.bytes = tree->leaf_pool.reserved + tree->internal_pool.reserved;
+#ifdef BPTREE_KEY_TYPE_STRING
+        for (int c = 0; c < BPTREE_PACK_CLASSES; c++) stats.bytes += tree->key_pools[c].reserved;
+#endif
+        stats.leaf_bytes = (size_t)stats.leaf_count * tree->leaf_pool.node_size;
+        stats.internal_bytes = (size_t)stats.internal_count * tree->internal_pool.node_size;
+        stats.fill_factor =
+            stats.leaf_count ? (double)stats.count / ((double)stats.leaf_count * tree->max_keys)
+                             : 0.0;
+        stats.ops.descents = __atomic_load_n(&tree->counters.descents, __ATOMIC_RELAXED);
+        stats.ops.nodes_visited = __atomic_load_n(&tree->counters.nodes_visited, __ATOMIC_RELAXED);
+        stats.ops.est_comparisons =
+            __atomic_load_n(&tree->counters.est_comparisons, __ATOMIC_RELAXED);
+        stats.ops.splits = __atomic_load_n(&tree->counters.splits, __ATOMIC_RELAXED);
+        stats.ops.merges = __atomic_load_n(&tree->counters.merges, __ATOMIC_RELAXED);
+        stats.ops.borrows = __atomic_load_n(&tree->counters.borrows, __ATOMIC_RELAXED);
     }
     return stats;
 }
@@ -1366,14 +3161,265 @@ BPTREE_API bool bptree_check_invariants(const bptree* tree) {
     return bptree_check_invariants_node(tree->root, tree, 0, &leaf_depth);
 }
 
+BPTREE_API void bptree_use_simd(const bool enable) {
+#ifdef BPTREE_SIMD_SEARCH
+    __atomic_store_n(&bptree_simd_level, enable ? bptree_detect_simd() : 0, __ATOMIC_RELAXED);
+#else
+    (void)enable;
+#endif
+}
+
 BPTREE_API bool bptree_contains(const bptree* tree, const bptree_key_t* key) {
     bptree_value_t dummy_value;
     return (bptree_get(tree, key, &dummy_value) == BPTREE_OK);
 }
 
-BPTREE_API bptree* bptree_create(const int max_keys,
+/** @brief Deepest path bptree_put_concurrent() keeps latches for. */
+#define BPTREE_MAX_HEIGHT_CONCURRENT 64
+
+/**
+ * @brief Read a node's version before reading the node.
+ *
+ * @param node Node about to be read.
+ * @param restart Set to true if a writer holds the node.
+ * @return The version to check against once the reads are done.
+ */
+static inline uint64_t bptree_latch_read(const bptree_node* node, bool* restart) {
+    const uint64_t version = __atomic_load_n(&node->version, __ATOMIC_ACQUIRE);
+    if (version & 1) *restart = true;
+    return version;
+}
+
+/**
+ * @brief Check that nothing wrote to a node since bptree_latch_read().
+ *
+ * @param node Node that was read.
+ * @param version Version returned by bptree_latch_read().
+ * @param restart Set to true if the node changed, in which case the reads are void.
+ */
+static inline void bptree_latch_check(const bptree_node* node, const uint64_t version,
+                                      bool* restart) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&node->version, __ATOMIC_RELAXED) != version) *restart = true;
+}
+
+/**
+ * @brief Turn an optimistic read into a write latch.
+ *
+ * @param node Node to latch.
+ * @param version Version returned by bptree_latch_read().
+ * @return True if latched, false if the node changed since it was read.
+ */
+static inline bool bptree_latch_upgrade(bptree_node* node, uint64_t version) {
+    return __atomic_compare_exchange_n(&node->version, &version, version + 1, false,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Release a write latch, moving the version on so optimistic readers restart.
+ *
+ * @param node Latched node.
+ */
+static inline void bptree_latch_release(bptree_node* node) {
+    __atomic_fetch_add(&node->version, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Back off briefly before restarting an optimistic descent.
+ */
+static inline void bptree_latch_pause(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+BPTREE_API bptree_status bptree_get_concurrent(const bptree* tree, const bptree_key_t* key,
+                                               bptree_value_t* out_value) {
+    if (!tree || !tree->root || !key || !out_value) return BPTREE_INVALID_ARGUMENT;
+    for (;; bptree_latch_pause()) {
+        // Only the attempt that finishes is counted, so contention doesn't inflate the
+        // per-descent numbers.
+        bptree_search_work work = {1, 0, 0};
+        bool restart = false;
+        bptree_node* node = __atomic_load_n(&tree->root, __ATOMIC_ACQUIRE);
+        uint64_t version = bptree_latch_read(node, &restart);
+        // A root that split after we loaded it only covers part of the key space now.
+        if (restart || node != __atomic_load_n(&tree->root, __ATOMIC_ACQUIRE)) continue;
+        while (!node->is_leaf && !restart) {
+            const int pos = bptree_node_search(tree, node, key);
+            bptree_search_note(&work, node);
+            bptree_node* child = bptree_node_children(node, tree->max_keys)[pos];
+            // The child pointer is only safe to follow if node didn't change under us.
+            bptree_latch_check(node, version, &restart);
+            if (restart) break;
+            const bptree_node* parent = node;
+            const uint64_t parent_version = version;
+            node = child;
+            version = bptree_latch_read(node, &restart);
+            bptree_latch_check(parent, parent_version, &restart);
+        }
+        if (restart) continue;
+        const int pos = bptree_node_search(tree, node, key);
+        bptree_search_note(&work, node);
+        const bool found = pos < node->num_keys && bptree_node_key_equals(tree, node, pos, key);
+        bptree_value_t value;
+        if (found) value = bptree_node_values(node, tree->max_keys)[pos];
+        bptree_latch_check(node, version, &restart);
+        if (restart) continue;
+        bptree_search_flush(tree, &work);
+        if (!found) return BPTREE_KEY_NOT_FOUND;
+        *out_value = value;
+        return BPTREE_OK;
+    }
+}
+
+BPTREE_API bptree_status bptree_put_concurrent(bptree* tree, const bptree_key_t* key,
+                                               bptree_value_t value) {
+    if (!tree || !tree->root || !key) return BPTREE_INVALID_ARGUMENT;
+    if (__atomic_load_n(&tree->newest_snapshot, __ATOMIC_ACQUIRE)) return BPTREE_INVALID_ARGUMENT;
+    bptree_node* path[BPTREE_MAX_HEIGHT_CONCURRENT];
+    uint64_t versions[BPTREE_MAX_HEIGHT_CONCURRENT];
+    for (;; bptree_latch_pause()) {
+        // Only the attempt that finishes is counted, as in bptree_get_concurrent().
+        bptree_search_work work = {1, 0, 0};
+        bool restart = false;
+        int depth = 0;
+        path[0] = __atomic_load_n(&tree->root, __ATOMIC_ACQUIRE);
+        versions[0] = bptree_latch_read(path[0], &restart);
+        if (restart || path[0] != __atomic_load_n(&tree->root, __ATOMIC_ACQUIRE)) continue;
+        // Optimistic descent, remembering the path and the version seen at each level.
+        while (!path[depth]->is_leaf && !restart) {
+            if (depth + 1 >= BPTREE_MAX_HEIGHT_CONCURRENT) return BPTREE_INTERNAL_ERROR;
+            const int pos = bptree_node_search(tree, path[depth], key);
+            bptree_node* child = bptree_node_children(path[depth], tree->max_keys)[pos];
+            bptree_latch_check(path[depth], versions[depth], &restart);
+            if (restart) break;
+            path[depth + 1] = child;
+            versions[depth + 1] = bptree_latch_read(child, &restart);
+            bptree_latch_check(path[depth], versions[depth], &restart);
+            depth++;
+        }
+        if (restart) continue;
+        // Full nodes split and push a key into their parent, so latch from the lowest
+        // ancestor with room (or the root) down to the leaf. Latches are only ever tried,
+        // never waited on, so writers can't deadlock.
+        int top = depth;
+        while (top > 0 && path[top]->num_keys >= tree->max_keys) top--;
+        int latched = top;
+        while (latched <= depth && bptree_latch_upgrade(path[latched], versions[latched])) {
+            latched++;
+        }
+        if (latched <= depth) {
+            for (int i = top; i < latched; i++) bptree_latch_release(path[i]);
+            continue;
+        }
+        // The latched nodes are exactly as we read them, so the sequential insert walks
+        // the same path and its splits stop at path[top]. It notes path[top..depth]
+        // itself, so only the nodes above top are noted here.
+        for (int i = 0; i < top; i++) bptree_search_note(&work, path[i]);
+        bptree_key_t promoted_key;
+        bptree_node* new_node = NULL;
+        bptree_status status =
+            bptree_insert_internal(tree, path[top], key, value, &promoted_key, &new_node, &work);
+        bptree_search_flush(tree, &work);
+        if (status == BPTREE_OK && new_node != NULL) {
+            status = top == 0 ? bptree_grow_root(tree, promoted_key, new_node)
+                              : BPTREE_INTERNAL_ERROR;
+        }
+        if (status == BPTREE_OK) __atomic_fetch_add(&tree->count, 1, __ATOMIC_RELAXED);
+        for (int i = top; i <= depth; i++) bptree_latch_release(path[i]);
+        return status;
+    }
+}
+
+BPTREE_API bptree_snapshot* bptree_snapshot_take(bptree* tree) {
+    if (!tree || !tree->root) return NULL;
+    bptree_snapshot* snapshot = malloc(sizeof(bptree_snapshot));
+    if (!snapshot) return NULL;
+    bptree_reclaim(tree);
+    snapshot->tree = tree;
+    snapshot->root = tree->root;
+    snapshot->count = tree->count;
+    snapshot->height = tree->height;
+    snapshot->gen = tree->gen;
+    snapshot->newer = NULL;
+    while (__atomic_test_and_set(&tree->snapshot_latch, __ATOMIC_ACQUIRE)) {
+    }
+    snapshot->older = tree->newest_snapshot;
+    if (snapshot->older) {
+        snapshot->older->newer = snapshot;
+    } else {
+        tree->oldest_snapshot = snapshot;
+    }
+    __atomic_store_n(&tree->newest_snapshot, snapshot, __ATOMIC_RELEASE);
+    __atomic_clear(&tree->snapshot_latch, __ATOMIC_RELEASE);
+    // Every node so far is now shared; nodes allocated from here on are the writer's.
+    tree->snapshot_gen = tree->gen;
+    tree->gen++;
+    bptree_debug_print(tree->enable_debug, "Snapshot taken at generation %llu.\n",
+                       (unsigned long long)snapshot->gen);
+    return snapshot;
+}
+
+BPTREE_API void bptree_snapshot_release(bptree_snapshot* snapshot) {
+    if (!snapshot) return;
+    bptree* tree = snapshot->tree;
+    while (__atomic_test_and_set(&tree->snapshot_latch, __ATOMIC_ACQUIRE)) {
+    }
+    if (snapshot->older) {
+        snapshot->older->newer = snapshot->newer;
+    } else {
+        tree->oldest_snapshot = snapshot->newer;
+    }
+    if (snapshot->newer) {
+        snapshot->newer->older = snapshot->older;
+    } else {
+        __atomic_store_n(&tree->newest_snapshot, snapshot->older, __ATOMIC_RELEASE);
+    }
+    // The writer picks this up at its next write; the latch orders our reads before reuse.
+    __atomic_store_n(&tree->snapshot_released, true, __ATOMIC_RELAXED);
+    __atomic_clear(&tree->snapshot_latch, __ATOMIC_RELEASE);
+    free(snapshot);
+}
+
+BPTREE_API bptree_status bptree_snapshot_get(const bptree_snapshot* snapshot,
+                                             const bptree_key_t* key, bptree_value_t* out_value) {
+    if (!snapshot || !key || !out_value) return BPTREE_INVALID_ARGUMENT;
+    if (snapshot->count == 0) return BPTREE_KEY_NOT_FOUND;
+    return bptree_get_from(snapshot->tree, snapshot->root, key, out_value);
+}
+
+BPTREE_API bptree_status bptree_snapshot_cursor_seek(const bptree_snapshot* snapshot,
+                                                     const bptree_key_t* start,
+                                                     const bptree_key_t* end,
+                                                     bptree_cursor* cursor) {
+    if (!snapshot || !cursor) return BPTREE_INVALID_ARGUMENT;
+    return bptree_cursor_start(snapshot->tree, snapshot->root, start, end, cursor);
+}
+
+BPTREE_API int bptree_max_keys_for_size(const size_t node_bytes) {
+    int max_keys = 3;
+    for (;;) {
+        const int next = max_keys + 1;
+#ifdef BPTREE_KEY_TYPE_STRING
+        // Packed keys sit in their own block; count them unpacked.
+        const size_t keys = (size_t)(next + 1) * BPTREE_KEY_SIZE;
+#else
+        const size_t keys = 0;
+#endif
+        if (bptree_node_pool_size(next, true) + keys > node_bytes ||
+            bptree_node_pool_size(next, false) + keys > node_bytes) {
+            break;
+        }
+        max_keys = next;
+    }
+    return max_keys;
+}
+
+BPTREE_API bptree* bptree_create(int max_keys,
                                  int (*compare)(const bptree_key_t*, const bptree_key_t*),
                                  const bool enable_debug) {
+    if (max_keys == BPTREE_AUTO_MAX_KEYS) max_keys = bptree_max_keys_for_size(BPTREE_NODE_BYTES);
     if (max_keys < 3) {
         fprintf(stderr, "[BPTREE CREATE] Error: max_keys must be at least 3.\n");
         return NULL;
@@ -1399,6 +3445,32 @@ BPTREE_API bptree* bptree_create(const int max_keys,
     bptree_debug_print(enable_debug, "Creating tree. max_keys=%d, min_internal=%d, min_leaf=%d\n",
                        tree->max_keys, tree->min_internal_keys, tree->min_leaf_keys);
     tree->compare = compare ? compare : bptree_default_compare;
+    tree->pool_latch = false;
+    tree->gen = 1;
+    tree->snapshot_gen = 0;
+    tree->oldest_snapshot = NULL;
+    tree->newest_snapshot = NULL;
+    tree->snapshot_latch = false;
+    tree->snapshot_released = false;
+    tree->retired = NULL;
+    tree->retired_count = 0;
+    tree->retired_capacity = 0;
+    tree->leaf_nodes = 0;
+    tree->internal_nodes = 0;
+    memset(&tree->counters, 0, sizeof(tree->counters));
+#ifdef BPTREE_SIMD_SEARCH
+    // Detected once; later trees, and a bptree_use_simd() before the first tree, keep it.
+    if (__atomic_load_n(&bptree_simd_level, __ATOMIC_RELAXED) < 0) {
+        int undetected = -1;
+        __atomic_compare_exchange_n(&bptree_simd_level, &undetected, bptree_detect_simd(), false,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    }
+#endif
+    bptree_pool_init(tree, &tree->leaf_pool, true);
+    bptree_pool_init(tree, &tree->internal_pool, false);
+#ifdef BPTREE_KEY_TYPE_STRING
+    bptree_key_pools_init(tree);
+#endif
     tree->root = bptree_node_alloc(tree, true);
     if (!tree->root) {
         fprintf(stderr, "[BPTREE CREATE] Error: Failed to allocate initial root node.\n");
@@ -1411,9 +3483,13 @@ BPTREE_API bptree* bptree_create(const int max_keys,
 
 BPTREE_API void bptree_free(bptree* tree) {
     if (!tree) return;
-    if (tree->root) {
-        bptree_free_node(tree->root, tree);
-    }
+    // Every node lives in a slab, so the whole tree goes without walking it.
+    bptree_pool_destroy(&tree->leaf_pool);
+    bptree_pool_destroy(&tree->internal_pool);
+#ifdef BPTREE_KEY_TYPE_STRING
+    for (int c = 0; c < BPTREE_PACK_CLASSES; c++) bptree_pool_destroy(&tree->key_pools[c]);
+#endif
+    free(tree->retired);
     free(tree);
 }
 
@@ -0,0 +1,178 @@
+#include <inttypes.h>
+#include <unistd.h>
+#include "bufferPool.h"
+
+static uint32_t hashPage(int fd, uint32_t page_id){
+	uint64_t h = ((uint64_t)(uint32_t)fd << 32) | page_id;
+	h *= 0x9e3779b97f4a7c15ULL;
+	return (uint32_t)(h >> 32);
+}
+
+bufferPool* bufferPoolCreate(size_t budgetBytes){
+	bufferPool* pool = malloc(sizeof(bufferPool));
+	if (pool == NULL){
+		printf("error allocating the buffer pool exiting..");
+		exit(1);
+	}
+	uint32_t numFrames = budgetBytes / PAGE_SIZE;
+	if (numFrames < 8){
+		numFrames = 8;
+	}
+	uint32_t numBuckets = 1;
+	while (numBuckets < numFrames * 2){
+		numBuckets <<= 1;
+	}
+	pool->pages = aligned_alloc(PAGE_SIZE, (size_t)numFrames * PAGE_SIZE);
+	pool->frames = malloc(numFrames * sizeof(frame));
+	pool->buckets = malloc(numBuckets * sizeof(int32_t));
+	if (pool->pages == NULL || pool->frames == NULL || pool->buckets == NULL){
+		printf("error allocating the buffer pool exiting..");
+		exit(1);
+	}
+	for (uint32_t i = 0; i < numFrames; i++){
+		pool->frames[i].fd = -1;
+		pool->frames[i].pinCount = 0;
+		pool->frames[i].dirty = false;
+		pool->frames[i].referenced = false;
+		pool->frames[i].nextInBucket = -1;
+	}
+	for (uint32_t i = 0; i < numBuckets; i++){
+		pool->buckets[i] = -1;
+	}
+	pool->numFrames = numFrames;
+	pool->clockHand = 0;
+	pool->bucketMask = numBuckets - 1;
+	pool->hits = 0;
+	pool->misses = 0;
+	pool->evictions = 0;
+	pool->writes = 0;
+	return pool;
+}
+
+void bufferPoolFree(bufferPool* pool){
+	free(pool->pages);
+	free(pool->frames);
+	free(pool->buckets);
+	free(pool);
+}
+
+static char* frameData(bufferPool* pool, uint32_t i){
+	return pool->pages + (size_t)i * PAGE_SIZE;
+}
+
+static void writeFrame(bufferPool* pool, uint32_t i){
+	frame* f = &pool->frames[i];
+	if (pwrite(f->fd, frameData(pool, i), PAGE_SIZE, (off_t)f->page_id * PAGE_SIZE) != PAGE_SIZE){
+		printf("error writing page %u exiting.. \n", f->page_id);
+		exit(1);
+	}
+	f->dirty = false;
+	pool->writes++;
+}
+
+static void unlinkFrame(bufferPool* pool, uint32_t i){
+	frame* f = &pool->frames[i];
+	int32_t* link = &pool->buckets[hashPage(f->fd, f->page_id) & pool->bucketMask];
+	while (*link != (int32_t)i){
+		link = &pool->frames[*link].nextInBucket;
+	}
+	*link = f->nextInBucket;
+	f->nextInBucket = -1;
+}
+
+// CLOCK: sweep the frames, giving referenced ones a second chance
+static uint32_t evictFrame(bufferPool* pool){
+	for (uint32_t scanned = 0; scanned < pool->numFrames * 2; scanned++){
+		uint32_t i = pool->clockHand;
+		pool->clockHand = (pool->clockHand + 1) % pool->numFrames;
+		frame* f = &pool->frames[i];
+		if (f->pinCount > 0){
+			continue;
+		}
+		if (f->referenced){
+			f->referenced = false;
+			continue;
+		}
+		if (f->fd >= 0){
+			if (f->dirty){
+				writeFrame(pool, i);
+			}
+			unlinkFrame(pool, i);
+			pool->evictions++;
+		}
+		return i;
+	}
+	printf("every page in the buffer pool is pinned exiting..");
+	exit(1);
+}
+
+// Returns the page's bytes, reading them in on a miss. Pages past the end of
+// the file come back zeroed so callers can extend a file by pinning them.
+char* bufferPoolPin(bufferPool* pool, int fd, uint32_t page_id){
+	uint32_t bucket = hashPage(fd, page_id) & pool->bucketMask;
+	for (int32_t i = pool->buckets[bucket]; i >= 0; i = pool->frames[i].nextInBucket){
+		frame* f = &pool->frames[i];
+		if (f->fd == fd && f->page_id == page_id){
+			f->pinCount++;
+			f->referenced = true;
+			pool->hits++;
+			return frameData(pool, i);
+		}
+	}
+	pool->misses++;
+	uint32_t i = evictFrame(pool);
+	char* data = frameData(pool, i);
+	ssize_t res = pread(fd, data, PAGE_SIZE, (off_t)page_id * PAGE_SIZE);
+	if (res < 0){
+		printf("error reading page %u exiting.. \n", page_id);
+		exit(1);
+	}
+	if (res < PAGE_SIZE){
+		memset(data + res, 0, PAGE_SIZE - res);
+	}
+	frame* f = &pool->frames[i];
+	f->fd = fd;
+	f->page_id = page_id;
+	f->pinCount = 1;
+	f->dirty = false;
+	f->referenced = true;
+	f->nextInBucket = pool->buckets[bucket];
+	pool->buckets[bucket] = i;
+	return data;
+}
+
+void bufferPoolUnpin(bufferPool* pool, char* page, bool dirty){
+	frame* f = &pool->frames[(page - pool->pages) / PAGE_SIZE];
+	f->pinCount--;
+	f->dirty = f->dirty || dirty;
+}
+
+// writes back every dirty page of one file
+void bufferPoolFlush(bufferPool* pool, int fd){
+	for (uint32_t i = 0; i < pool->numFrames; i++){
+		if (pool->frames[i].fd == fd && pool->frames[i].dirty){
+			writeFrame(pool, i);
+		}
+	}
+}
+
+// drops every cached page of one file without writing anything back
+void bufferPoolDiscard(bufferPool* pool, int fd){
+	for (uint32_t i = 0; i < pool->numFrames; i++){
+		frame* f = &pool->frames[i];
+		if (f->fd == fd){
+			unlinkFrame(pool, i);
+			f->fd = -1;
+			f->dirty = false;
+			f->referenced = false;
+		}
+	}
+}
+
+void bufferPoolPrintStats(const bufferPool* pool){
+	uint64_t total = pool->hits + pool->misses;
+	printf("buffer pool: %u frames, %" PRIu64 " hits, %" PRIu64 " misses (%.1f%% hit rate), %" PRIu64
+		" evictions, %" PRIu64 " writes \n",
+		pool->numFrames, pool->hits, pool->misses, total ? 100.0 * pool->hits / total : 0.0,
+		pool->evictions, pool->writes);
+}
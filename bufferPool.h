@@ -0,0 +1,40 @@
+#pragma once
+#include <stdbool.h>
+#include "db.h"
+
+#define BUFFER_POOL_BYTES (16 * 1024 * 1024) // default memory budget for cached pages
+
+// A fixed set of PAGE_SIZE frames shared by every file the DB reads, keyed by
+// (fd, page_id). Pages are pinned while in use and only unpinned frames can
+// be evicted, picked with the CLOCK algorithm. Dirty frames are written back
+// on eviction or on bufferPoolFlush().
+
+typedef struct frame {
+	int fd;           // -1 when the frame is empty
+	uint32_t page_id;
+	int pinCount;
+	bool dirty;
+	bool referenced;  // CLOCK bit, set on every pin
+	int32_t nextInBucket;
+} frame;
+
+typedef struct bufferPool {
+	char* pages;      // numFrames * PAGE_SIZE, page aligned
+	frame* frames;
+	uint32_t numFrames;
+	uint32_t clockHand;
+	int32_t* buckets; // hash of (fd, page_id) -> first frame in the chain
+	uint32_t bucketMask;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+	uint64_t writes;
+} bufferPool;
+
+bufferPool* bufferPoolCreate(size_t budgetBytes);
+void bufferPoolFree(bufferPool* pool);
+char* bufferPoolPin(bufferPool* pool, int fd, uint32_t page_id);
+void bufferPoolUnpin(bufferPool* pool, char* page, bool dirty);
+void bufferPoolFlush(bufferPool* pool, int fd);
+void bufferPoolDiscard(bufferPool* pool, int fd);
+void bufferPoolPrintStats(const bufferPool* pool);
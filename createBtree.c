@@ -1,42 +1,100 @@
+#include <inttypes.h>
 #include "createBtree.h"
-static int record_compare(const bptree_key_t *a, const bptree_key_t *b)
-{
-    // Assumes BPTREE_NUMERIC_TYPE is defined (default is int64_t)
-    return (*a < *b) ? -1 : ((*a > *b) ? 1 : 0);
-}
 
-void constructTree(FILE *db, bptree *tree)
+// Rebuilds the index from dbFile.bin. Only needed for a data file that was
+// written before index.bin existed, the index is persisted otherwise.
+// The scan reads through its own sequential mapping so it doesn't flush the
+// buffer pool's hot pages out. Rows are normally stored in id order, so the
+// index is built bottom-up in one pass; the first id that arrives out of order
+// switches the rest of the rebuild over to regular puts.
+void constructTree(int db, pageIndex *index)
 {
     printf("constructing the Btree \n");
-    int page_id = 0;
-    int offset = 0;
-    record_t * retrievalRow = NULL;
-    while (fread(retrievalRow, sizeof(struct record_t*), 1, db))
+    indexBuilder builder;
+    bool building = true;
+    pageIndexBuildStart(&builder, index, INDEX_BULK_FILL);
+    mmapReader *reader = mmapReaderOpen(db, MMAP_SEQUENTIAL);
+    uint32_t numPages = mmapReaderPages(reader);
+    for (uint32_t page_id = 0; page_id < numPages; page_id++)
+    {
+        const char *page = mmapReaderPage(reader, page_id);
+        for (uint16_t i = 0; i < pageNumSlots(page); i++)
+        {
+            rowLocator loc = {page_id, pageRowOffset(page, i)};
+            int64_t id;
+            memcpy(&id, pageColumnAt(page, loc.offset, COLUMN_ID), sizeof(int64_t));
+            if (building && pageIndexBuildAdd(&builder, id, loc))
+            {
+                continue;
+            }
+            if (building)
+            {
+                pageIndexBuildFinish(&builder);
+                building = false;
+            }
+            if (pageIndexPut(index, id, loc))
+            {
+                printf("duplicate id %ld in the db \n", id);
+            }
+        }
+    }
+    mmapReaderClose(reader);
+    if (building)
     {
-        printf("yo here \n");
-        // long curPos = ftell(db);
-        // page_id = curPos / PAGE_SIZE;
-        // offset = curPos - (page_id * PAGE_SIZE);
-        // printf("record I am inserting, id: %d \n", &retrievalRow->id);
-        // bptree_status status = bptree_put(tree, &retrievalRow->id, retrievalRow);
-        // if (status != BPTREE_OK)
-        // {
-        //     printf("shoot \n");
-        // }
+        pageIndexBuildFinish(&builder);
     }
+    pageIndexFlush(index);
 }
 
-static record_t *create_record(const bptree_key_t id, uint32_t page_id, uint32_t offset)
+typedef struct replayTarget
 {
-    record_t *rec = malloc(sizeof(record_t));
-    if (!rec)
+    int db;
+    bufferPool *pool;
+    pageIndex *index;
+    struct Row *rows;
+    size_t numRows;
+    size_t batchSize;
+} replayTarget;
+
+// rows are applied a log batch at a time, appendRows flushes the pool on
+// every call
+static void replayRow(const struct Row *row, void *arg)
+{
+    replayTarget *target = arg;
+    target->rows[target->numRows++] = *row;
+    if (target->numRows == target->batchSize)
     {
-        perror("Failed to allocate memory for record");
-        return NULL;
+        appendRows(target->db, target->pool, target->rows, target->numRows, target->index, NULL);
+        target->numRows = 0;
     }
+}
 
-    rec->id = id;
-    rec->page_id = page_id;
-    rec->offset = offset;
-    return rec;
-}
\ No newline at end of file
+// Brings dbFile.bin and index.bin back in line with the WAL after a crash.
+// Index pages may have been evicted half way through a split, so the index is
+// rebuilt from the data file first, then any logged row that never reached
+// the data file is applied again. A clean shutdown leaves the log empty and
+// this does nothing.
+void recoverFromWal(int db, bufferPool *pool, pageIndex *index, wal *log)
+{
+    if (log->end == sizeof(walFileHeader))
+    {
+        return;
+    }
+    printf("recovering from the WAL \n");
+    pageIndexReset(index);
+    constructTree(db, index);
+    replayTarget target = {db, pool, index, malloc(log->batchSize * sizeof(struct Row)), 0, log->batchSize};
+    if (target.rows == NULL)
+    {
+        printf("error allocating the replay batch exiting..");
+        exit(1);
+    }
+    uint64_t replayed = walReplay(log, replayRow, &target);
+    if (target.numRows > 0)
+    {
+        appendRows(db, pool, target.rows, target.numRows, index, NULL);
+    }
+    free(target.rows);
+    checkpoint(db, pool, index, log);
+    printf("replayed %" PRIu64 " logged rows \n", replayed);
+}
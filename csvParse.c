@@ -0,0 +1,224 @@
+#include <pthread.h>
+#include <unistd.h>
+#include "csvParse.h"
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
+// bit i is set if block[i] is ',' or '\n'
+typedef uint64_t (*delimMaskFn)(const char* block);
+
+static uint64_t delimMaskScalar(const char* block){
+	uint64_t mask = 0;
+	for (int i = 0; i < 64; i++){
+		if (block[i] == ',' || block[i] == '\n'){
+			mask |= 1ULL << i;
+		}
+	}
+	return mask;
+}
+
+#ifdef __x86_64__
+// SSE2 is part of x86-64, so this one needs no check
+static uint64_t delimMaskSse2(const char* block){
+	const __m128i comma = _mm_set1_epi8(',');
+	const __m128i newline = _mm_set1_epi8('\n');
+	uint64_t mask = 0;
+	for (int i = 0; i < 4; i++){
+		__m128i bytes = _mm_loadu_si128((const __m128i*)(block + 16 * i));
+		__m128i hits = _mm_or_si128(_mm_cmpeq_epi8(bytes, comma), _mm_cmpeq_epi8(bytes, newline));
+		mask |= (uint64_t)(uint16_t)_mm_movemask_epi8(hits) << (16 * i);
+	}
+	return mask;
+}
+
+__attribute__((target("avx2")))
+static uint64_t delimMaskAvx2(const char* block){
+	const __m256i comma = _mm256_set1_epi8(',');
+	const __m256i newline = _mm256_set1_epi8('\n');
+	__m256i low = _mm256_loadu_si256((const __m256i*)block);
+	__m256i high = _mm256_loadu_si256((const __m256i*)(block + 32));
+	__m256i lowHits = _mm256_or_si256(_mm256_cmpeq_epi8(low, comma), _mm256_cmpeq_epi8(low, newline));
+	__m256i highHits = _mm256_or_si256(_mm256_cmpeq_epi8(high, comma), _mm256_cmpeq_epi8(high, newline));
+	return (uint64_t)(uint32_t)_mm256_movemask_epi8(lowHits)
+		| (uint64_t)(uint32_t)_mm256_movemask_epi8(highHits) << 32;
+}
+#endif
+
+static delimMaskFn delimMask = delimMaskScalar;
+
+static void pickDelimMask(){
+#ifdef __x86_64__
+	__builtin_cpu_init();
+	delimMask = __builtin_cpu_supports("avx2") ? delimMaskAvx2 : delimMaskSse2;
+#endif
+}
+
+// digits only (and an optional '-'), no strtol so nothing needs terminating
+static bool parseId(const char* p, const char* end, int64_t* out){
+	bool negative = false;
+	if (p < end && *p == '-'){
+		negative = true;
+		p++;
+	}
+	if (p == end || end - p > 19){
+		return false;
+	}
+	uint64_t value = 0;
+	for (; p < end; p++){
+		unsigned digit = (unsigned char)*p - '0';
+		if (digit > 9){
+			return false;
+		}
+		value = value * 10 + digit;
+	}
+	if (value > (uint64_t)INT64_MAX + negative){
+		return false;
+	}
+	*out = negative ? (int64_t)(0 - value) : (int64_t)value;
+	return true;
+}
+
+// zero fills the rest of dst so rows are the same bytes every time they're logged
+static bool copyField(char* dst, size_t dstSize, const char* src, const char* end){
+	size_t len = end - src;
+	if (len >= dstSize){
+		return false;
+	}
+	memcpy(dst, src, len);
+	memset(dst + len, 0, dstSize - len);
+	return true;
+}
+
+static void emitLine(csvRange* range, const char* line, const char** commas, int numCommas, const char* end){
+	if (range->numRows == range->capacity){
+		size_t capacity = range->capacity ? range->capacity * 2 : 1024;
+		struct Row* rows = realloc(range->rows, capacity * sizeof(struct Row));
+		if (rows == NULL){
+			printf("error growing the csv row buffer exiting..");
+			exit(1);
+		}
+		range->rows = rows;
+		range->capacity = capacity;
+	}
+	if (end > line && end[-1] == '\r'){
+		end--;
+	}
+	struct Row* row = &range->rows[range->numRows];
+	if (numCommas < 2
+		|| !parseId(line, commas[0], &row->id)
+		|| !copyField(row->name, NAME_SIZE, commas[0] + 1, commas[1])
+		|| !copyField(row->location, LOCATION_SIZE, commas[1] + 1, end)){
+		range->malformed++;
+		return;
+	}
+	range->numRows++;
+}
+
+// Walks the delimiter bitmask one 64 byte block at a time. Only the first two
+// commas of a line split fields, the location keeps any after that.
+static void* parseRange(void* arg){
+	csvRange* range = arg;
+	const char* lineStart = range->start;
+	const char* commas[2];
+	int numCommas = 0;
+	range->numRows = 0;
+	range->malformed = 0;
+	for (const char* block = range->start; block < range->end; block += 64){
+		uint64_t mask = delimMask(block);
+		if (range->end - block < 64){
+			mask &= (1ULL << (range->end - block)) - 1;
+		}
+		while (mask){
+			const char* hit = block + __builtin_ctzll(mask);
+			mask &= mask - 1;
+			if (*hit == ','){
+				if (numCommas < 2){
+					commas[numCommas++] = hit;
+				}
+				continue;
+			}
+			// blank lines are ignored
+			if (hit > lineStart){
+				emitLine(range, lineStart, commas, numCommas, hit);
+			}
+			lineStart = hit + 1;
+			numCommas = 0;
+		}
+	}
+	return NULL;
+}
+
+csvParser* csvParserCreate(int numThreads){
+	csvParser* parser = calloc(1, sizeof(csvParser));
+	if (parser == NULL){
+		printf("error allocating the csv parser exiting..");
+		exit(1);
+	}
+	if (numThreads < 1){
+		numThreads = 1;
+	}
+	parser->numThreads = numThreads < CSV_MAX_THREADS ? numThreads : CSV_MAX_THREADS;
+	pickDelimMask();
+	return parser;
+}
+
+void csvParserFree(csvParser* parser){
+	for (int i = 0; i < CSV_MAX_THREADS; i++){
+		free(parser->ranges[i].rows);
+	}
+	free(parser);
+}
+
+int csvDefaultThreads(){
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cores < 1){
+		return 1;
+	}
+	return cores < CSV_MAX_THREADS ? cores : CSV_MAX_THREADS;
+}
+
+// input has to hold whole lines (ending in '\n') and be followed by
+// CSV_PADDING readable bytes. The rows are in parser->ranges[0..numRanges).
+void csvParse(csvParser* parser, const char* input, size_t len){
+	const char* end = input + len;
+	size_t numRanges = len / CSV_MIN_RANGE;
+	if (numRanges < 1){
+		numRanges = 1;
+	}
+	if (numRanges > (size_t)parser->numThreads){
+		numRanges = parser->numThreads;
+	}
+	const char* start = input;
+	for (size_t i = 0; i < numRanges; i++){
+		const char* stop = end;
+		if (i + 1 < numRanges){
+			// move the even split point to the end of the line it falls in
+			const char* cut = input + len / numRanges * (i + 1);
+			if (cut < start){
+				cut = start;
+			}
+			const char* newline = memchr(cut, '\n', end - cut);
+			stop = newline ? newline + 1 : end;
+		}
+		parser->ranges[i].start = start;
+		parser->ranges[i].end = stop;
+		start = stop;
+	}
+	parser->numRanges = numRanges;
+
+	pthread_t threads[CSV_MAX_THREADS];
+	bool started[CSV_MAX_THREADS] = {false};
+	for (size_t i = 1; i < numRanges; i++){
+		started[i] = pthread_create(&threads[i], NULL, parseRange, &parser->ranges[i]) == 0;
+		if (!started[i]){
+			parseRange(&parser->ranges[i]);
+		}
+	}
+	parseRange(&parser->ranges[0]);
+	for (size_t i = 1; i < numRanges; i++){
+		if (started[i]){
+			pthread_join(threads[i], NULL);
+		}
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <stdbool.h>
+#include "db.h"
+
+#define CSV_MAX_THREADS 8
+#define CSV_MIN_RANGE (64 * 1024) // smaller inputs aren't worth another thread
+#define CSV_PADDING 64 // readable bytes callers leave after the input, the scanner reads whole blocks
+
+// Parses "id,name,location" lines in parallel. The input is cut into one
+// range per thread at newline boundaries, each thread finds the ',' and '\n'
+// bytes 64 at a time with SIMD compares and fills its own rows, and the
+// ranges are read back in order so rows come out in file order.
+
+typedef struct csvRange {
+	const char* start;
+	const char* end;
+	struct Row* rows;
+	size_t numRows;
+	size_t capacity;
+	size_t malformed;
+} csvRange;
+
+typedef struct csvParser {
+	int numThreads;
+	int numRanges; // ranges filled by the last csvParse()
+	csvRange ranges[CSV_MAX_THREADS];
+} csvParser;
+
+csvParser* csvParserCreate(int numThreads);
+void csvParserFree(csvParser* parser);
+int csvDefaultThreads();
+void csvParse(csvParser* parser, const char* input, size_t len);
@@ -1,3 +1,5 @@
+#include <fcntl.h>
+#include <unistd.h>
 #include "db.h"
 
 FILE* openFile(char *filePath, char* mode){
@@ -7,4 +9,33 @@ FILE* openFile(char *filePath, char* mode){
 		exit(1);
 	}
 	return db;
-}
\ No newline at end of file
+}
+
+// dbFile.bin is read and written a whole page at a time, so it is opened as a
+// plain descriptor instead of going through stdio buffering
+int openDataFile(char *filePath){
+	int db = open(filePath, O_RDWR | O_CREAT, 0644);
+	if (db < 0){
+		printf("error opening the DB exiting..");
+		exit(1);
+	}
+	return db;
+}
+
+uint32_t dataFilePages(int db){
+	return lseek(db, 0, SEEK_END) / PAGE_SIZE;
+}
+
+void readDataPage(int db, uint32_t page_id, char* page){
+	if (pread(db, page, PAGE_SIZE, (off_t)page_id * PAGE_SIZE) != PAGE_SIZE){
+		printf("error reading page %u exiting.. \n", page_id);
+		exit(1);
+	}
+}
+
+void writeDataPage(int db, uint32_t page_id, const char* page){
+	if (pwrite(db, page, PAGE_SIZE, (off_t)page_id * PAGE_SIZE) != PAGE_SIZE){
+		printf("error writing page %u exiting.. \n", page_id);
+		exit(1);
+	}
+}
@@ -7,6 +7,7 @@
 #define NAME_SIZE 64
 #define LOCATION_SIZE 64
 #define PATH_TO_DB "dbFile.bin"
+#define PAGE_SIZE 4096 // bytes
 
 struct Row {
 	int64_t id;
@@ -14,4 +15,24 @@ struct Row {
 	char location[LOCATION_SIZE];
 };
 
+typedef enum {
+	COLUMN_NAME,
+	COLUMN_LOCATION,
+	COLUMN_ID // not a secondary index column, only scans use it
+} rowColumn;
+
+// where a row lives in dbFile.bin
+typedef struct rowLocator {
+	uint32_t page_id;
+	uint32_t offset;
+} rowLocator;
+
+// bptree.h stores the locator itself as the value, so a key costs no
+// allocation of its own and a lookup has nothing more to dereference
+#define BPTREE_VALUE_TYPE rowLocator
+
 FILE* openFile(char *filePath, char* mode);
+int openDataFile(char *filePath);
+uint32_t dataFilePages(int db);
+void readDataPage(int db, uint32_t page_id, char* page);
+void writeDataPage(int db, uint32_t page_id, const char* page);
@@ -217,9 +217,9 @@ static void cleanup_records_and_tree(bptree* tree) {
  * @return EXIT_SUCCESS on successful execution, EXIT_FAILURE otherwise.
  */
 int main(void) {
-    // Create the B+ tree with max_keys = 4 (Order 5)
+    // Create the B+ tree with as many keys per node as fit in a 4KB page (BPTREE_NODE_BYTES)
     // Store pointers to record_t structs (BPTREE_VALUE_TYPE)
-    bptree* tree = bptree_create(4, record_compare, debug_enabled);
+    bptree* tree = bptree_create(BPTREE_AUTO_MAX_KEYS, record_compare, debug_enabled);
     if (!tree) {
         fprintf(stderr, "Error: failed to create B+ tree\n");
         return EXIT_FAILURE;
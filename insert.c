@@ -1,80 +1,172 @@
+#include <fcntl.h>
+#include <unistd.h>
 #include "insert.h"
 
 
 // intiially, data will be structured as  [id | name | location] - for easy mapping in the file
-void insert(FILE* db, struct Row* data, size_t * dataLen, bptree* tree){
-	printf("inserting into the db \n \n");
-	// start at 1 so we don't write the header
-	int page_id=0;
-	int offset = 0;
-	for(size_t i =1; i < *dataLen; i++){
-		long curPos = ftell(db);
-		page_id = curPos / PAGE_SIZE;
-		offset = curPos - (page_id*PAGE_SIZE);
-		record_t * rec = create_record((long long)data[i].id, page_id, offset);
-		constructTree(db, tree);	
-		bptree_status status = bptree_put(tree, &rec->id, rec);
-		if (status != BPTREE_OK) {
-		printf("shoot \n");
+// rows are packed into slotted pages (see page.h), the last page of the file
+// is topped up first and pages go through the buffer pool like every read.
+// Nothing is logged here, callers make the rows durable in the WAL first.
+// secondary may be NULL, and isn't touched until its first lookup has built it.
+size_t appendRows(int db, bufferPool* pool, const struct Row* rows, size_t numRows, pageIndex* index,
+	secondaryIndexes* secondary){
+	uint32_t page_id = dataFilePages(db);
+	char* page;
+	size_t inserted = 0;
+	if (page_id > 0){
+		page_id--;
+		page = bufferPoolPin(pool, db, page_id);
+	}
+	else{
+		page = bufferPoolPin(pool, db, page_id);
+		pageInit(page);
+	}
+	for(size_t i = 0; i < numRows; i++){
+		if (!pageHasRoom(page, sizeof(struct Row))){
+			bufferPoolUnpin(pool, page, true);
+			page_id++;
+			page = bufferPoolPin(pool, db, page_id);
+			pageInit(page);
 		}
-		int res = fwrite(&data[i], sizeof(struct Row), 1, db);
-		if (!res){
-			printf("Error occured while writing exiting \n");
+		rowLocator loc;
+		loc.page_id = page_id;
+		loc.offset = pageNextOffset(page, sizeof(struct Row));
+		// already in the db, skipped and counted by the caller
+		if (pageIndexPut(index, rows[i].id, loc)){
+			continue;
 		}
-		else{
-			printf("Successfully inserted : %d, %s, %s \n", data[i].id, data[i].name, data[i].location);
+		pageInsertRow(page, &rows[i], sizeof(struct Row));
+		if (secondary != NULL && secondary->built){
+			secondaryIndexesAdd(secondary, &rows[i], loc);
 		}
+		inserted++;
 	}
-	printf("data was successfully inserted into the DB \n");
+	bufferPoolUnpin(pool, page, true);
+	// the page count comes from the file size, so the tail page has to land
+	bufferPoolFlush(pool, db);
+	return inserted;
 }
 
-size_t loopOverCSV(struct Row* arrayOfRows, FILE* csv){
-	char line[1024];
-	int count =0;
-	while(fgets(line, sizeof(line), csv)){
-		if (arrayOfRows != NULL){
-			arrayOfRows[count].id = strtol(strtok(line,","), NULL, 10);
-			strcpy(arrayOfRows[count].name , strtok(NULL,","));
-			strcpy(arrayOfRows[count].location , strtok(NULL,","));
-			// printf("parsed : %ld, %s, %s \n", arrayOfRows[count].id, arrayOfRows[count].name, arrayOfRows[count].location);
-		}
-		count+=1;
+// Makes dbFile.bin and index.bin durable, after which the log can be emptied.
+void checkpoint(int db, bufferPool* pool, pageIndex* index, wal* log){
+	bufferPoolFlush(pool, db);
+	pageIndexFlush(index);
+	if (fsync(db) != 0 || fsync(index->fd) != 0){
+		printf("error syncing the DB exiting..");
+		exit(1);
 	}
-	return count;
+	walCheckpoint(log);
 }
 
-static record_t* create_record(const bptree_key_t id, uint32_t page_id, uint32_t offset) {
-    record_t* rec = malloc(sizeof(record_t));
-    if (!rec) {
-        perror("Failed to allocate memory for record");
-        return NULL;
-    }
-
-	rec->id = id;
-	rec->page_id = page_id;
-	rec->offset = offset;
-    return rec;
+// Logs one group of rows: one fsync covers the whole group, and only then are
+// the rows written into the data file and the index.
+size_t insertBatch(int db, bufferPool* pool, wal* log, const struct Row* rows, size_t numRows, pageIndex* index,
+	secondaryIndexes* secondary){
+	uint64_t lsn = 0;
+	for (size_t i = 0; i < numRows; i++){
+		lsn = walAppend(log, &rows[i]);
+	}
+	walCommit(log, lsn);
+	return appendRows(db, pool, rows, numRows, index, secondary);
 }
 
-
-struct Row* parseIncomingData(char* filePath, size_t*fileLen ){
-	struct Row* arrayOfRows = NULL;
+// Streams a CSV into the db. The file is read INGEST_CHUNK_SIZE bytes at a
+// time, the whole lines in the chunk are parsed in parallel (see csvParse.h)
+// and the rows are copied into a batch of log->batchSize rows, which is
+// logged and written as soon as it fills. Memory stays the same whatever the
+// file size and the first rows are durable before the rest has been read.
+// Every INGEST_CHECKPOINT_BATCHES batches the data file and index are synced
+// and the log emptied, so wal.bin doesn't grow with the file.
+// A line cut off at the end of a chunk is moved to the front of the buffer
+// and finished by the next read.
+size_t ingestCSV(char* filePath, int db, bufferPool* pool, wal* log, pageIndex* index, secondaryIndexes* secondary){
 	printf("opening csv..  %s \n", filePath);
-	FILE* csv = fopen(filePath, "r");
-	*fileLen = loopOverCSV(arrayOfRows, csv) - 1;
-	fseek(csv,0, SEEK_SET);
-	arrayOfRows = malloc(*fileLen*sizeof(struct Row));
-	loopOverCSV(arrayOfRows, csv);
-	return arrayOfRows;
+	int csv = open(filePath, O_RDONLY);
+	if (csv < 0){
+		printf("could not open %s \n", filePath);
+		return 0;
+	}
+	posix_fadvise(csv, 0, 0, POSIX_FADV_SEQUENTIAL);
+	// one spare byte so a last line without a '\n' can be given one
+	char* chunk = malloc(INGEST_CHUNK_SIZE + 1 + CSV_PADDING);
+	struct Row* batch = malloc(log->batchSize * sizeof(struct Row));
+	if (chunk == NULL || batch == NULL){
+		printf("error allocating the ingest buffers exiting..");
+		exit(1);
+	}
+	csvParser* parser = csvParserCreate(csvDefaultThreads());
+	printf("inserting into the db \n \n");
+	size_t held = 0; // bytes of an unfinished line at the front of chunk
+	bool headerSkipped = false;
+	size_t numRows = 0;
+	size_t batches = 0;
+	size_t parsed = 0;
+	size_t malformed = 0;
+	size_t inserted = 0;
+	while (true){
+		if (held == INGEST_CHUNK_SIZE){
+			printf("a line in %s is too long exiting..", filePath);
+			exit(1);
+		}
+		ssize_t got = read(csv, chunk + held, INGEST_CHUNK_SIZE - held);
+		if (got < 0){
+			printf("error reading %s exiting..", filePath);
+			exit(1);
+		}
+		size_t filled = held + got;
+		if (got == 0 && held > 0){
+			chunk[filled++] = '\n';
+		}
+		size_t whole = filled;
+		while (whole > 0 && chunk[whole - 1] != '\n'){
+			whole--;
+		}
+		char* start = chunk;
+		if (!headerSkipped && whole > 0){
+			start = memchr(chunk, '\n', whole) + 1;
+			headerSkipped = true;
+		}
+		csvParse(parser, start, chunk + whole - start);
+		for (int r = 0; r < parser->numRanges; r++){
+			csvRange* range = &parser->ranges[r];
+			malformed += range->malformed;
+			parsed += range->numRows;
+			for (size_t i = 0; i < range->numRows; i++){
+				batch[numRows++] = range->rows[i];
+				if (numRows == log->batchSize){
+					inserted += insertBatch(db, pool, log, batch, numRows, index, secondary);
+					numRows = 0;
+					// keeps wal.bin, and the replay after a crash, to a few batches
+					if (++batches % INGEST_CHECKPOINT_BATCHES == 0){
+						checkpoint(db, pool, index, log);
+					}
+				}
+			}
+		}
+		held = filled - whole;
+		memmove(chunk, chunk + whole, held);
+		if (got == 0){
+			break;
+		}
+	}
+	if (numRows > 0){
+		inserted += insertBatch(db, pool, log, batch, numRows, index, secondary);
+	}
+	if (malformed > 0){
+		printf("skipped %zu malformed lines \n", malformed);
+	}
+	if (parsed > inserted){
+		printf("skipped %zu rows whose id is already in the db \n", parsed - inserted);
+	}
+	close(csv);
+	free(chunk);
+	free(batch);
+	csvParserFree(parser);
+	checkpoint(db, pool, index, log);
+	printf("inserted %zu rows into the DB \n", inserted);
+	return inserted;
 }
 
-static void print_key(const bptree_key_t key) {
-    printf("FOUND KEY : %lld \n", (long long)key);  // Use %lld for int64_t
-}
-static void print_value(const bptree_value_t value) {
-    printf("FOUND PAGE_ID : %lld \n", (long long)value->page_id);  
-    printf("FOUND PAGE_ID : %lld \n", (long long)value->offset);  
-}
 
 
 // int main(int argc, char * argv[]){
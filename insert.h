@@ -1,18 +1,19 @@
-#define BPTREE_VALUE_TYPE struct record*  // Configure tree to store pointers to records
 #pragma once
 #include "db.h"
 #include "bptree.h"
-#define PAGE_SIZE 4096 // bytes
+#include "pageIndex.h"
+#include "page.h"
+#include "wal.h"
+#include "csvParse.h"
+#include "secondaryIndex.h"
 #define BPTREE_IMPLEMENTATION
+#define INGEST_CHUNK_SIZE (4 << 20) // bytes of CSV read per chunk, split between the parser threads
+#define INGEST_CHECKPOINT_BATCHES 64 // log batches between checkpoints, bounds wal.bin and crash replay
 
-typedef struct record {
-    /** @brief The numeric key used for indexing in the B+ tree. */
-    int64_t id;
-	uint32_t page_id;
-	uint32_t offset;
-} record_t;
 
-
-void insert(FILE* db, struct Row* data, size_t * dataLen, bptree* tree);
-struct Row* parseIncomingData(char* filePath, size_t*fileLen);
-static record_t* create_record(const bptree_key_t id, uint32_t page_id, uint32_t offset);
\ No newline at end of file
+size_t appendRows(int db, bufferPool* pool, const struct Row* rows, size_t numRows, pageIndex* index,
+	secondaryIndexes* secondary);
+void checkpoint(int db, bufferPool* pool, pageIndex* index, wal* log);
+size_t insertBatch(int db, bufferPool* pool, wal* log, const struct Row* rows, size_t numRows, pageIndex* index,
+	secondaryIndexes* secondary);
+size_t ingestCSV(char* filePath, int db, bufferPool* pool, wal* log, pageIndex* index, secondaryIndexes* secondary);
\ No newline at end of file
@@ -7,48 +7,184 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
 #define PATH_TO_DB "dbFile.bin"
+#define FIND_MAX_ROWS 20 // rows printed per find, the rest are only counted
 #include "createBtree.h"
+#include "retrieve.h"
+#include "aggregate.h"
 
 
-FILE * dbFile;
-bptree * tree;
+int dbFile;
+bufferPool * pool;
+pageIndex * idIndex;
+wal * walLog;
+secondaryIndexes * nameLocationIndex;
+mmapReader * dataReader;
+
+static void printRow(const struct Row* row, void* arg){
+    (void)arg;
+    printf("found row: %ld, %s, %s \n", row->id, row->name, row->location);
+}
 
 int main(){
     
     // printf("_|_     _|_     _|_     _|_     _|_     _|_     _|_     _\n \n");
     printf("Welcome to the DB ^_^ \n");
+    // every page read by the shell goes through this pool
+    pool = bufferPoolCreate(BUFFER_POOL_BYTES);
+    dbFile = openDataFile(PATH_TO_DB);
+    // opening the index only reads its meta page, nothing is rebuilt here
+    idIndex = pageIndexOpen(PATH_TO_INDEX, pool);
+    walLog = walOpen(PATH_TO_WAL, WAL_BATCH_SIZE, WAL_COMMIT_INTERVAL_US);
+    recoverFromWal(dbFile, pool, idIndex, walLog);
+    // gets and finds copy rows out of this mapping, it is remapped as the file grows
+    dataReader = mmapReaderOpen(dbFile, MMAP_RANDOM);
+    // empty until the first find fills it, inserts keep it current after that
+    nameLocationIndex = secondaryIndexesCreate();
     while(true){
-        printf("Would you like to read or insert (r/i)? \n");
-        char input;
-        scanf("%c", &input);
+        printf("Would you like to read, insert, find, read a range, group or see stats (r/i/f/b/g/s)? \n");
+        // whole words work too, only the first letter counts
+        char mode[16];
+        if (scanf(" %15s", mode) != 1){
+            break;
+        }
+        char input = mode[0];
 
         if (input == 'i'){
             printf("===== insert mode ======= \n \n");
-            dbFile = openFile(PATH_TO_DB, "ab");
 
             printf("enter a path to a file \n");
             char filePath[256];
             scanf("%s", filePath);
             printf("the file path is : %s \n", filePath);
-            size_t * fileLen = malloc(sizeof(size_t)); // length of the file which will be updated in `parseIncomingData`
-	        struct Row* data =  parseIncomingData(filePath, fileLen);
-            insert(dbFile, data, fileLen, tree);
-            fclose(dbFile);
+            // streamed in batches, memory use doesn't depend on the file size
+            ingestCSV(filePath, dbFile, pool, walLog, idIndex, nameLocationIndex);
+            continue;
+        }
+        if (input == 'f'){
+            printf("===== find mode ======= \n");
+            if (!nameLocationIndex->built){
+                secondaryIndexesBuild(nameLocationIndex, dbFile);
+            }
+            printf("enter name or location and a value, end the value with * to match a prefix \n");
+            char column[16];
+            char value[SECONDARY_COLUMN_SIZE + 1];
+            if (scanf("%15s %64[^\n]", column, value) != 2){
+                continue;
+            }
+            if (strcmp(column, "name") != 0 && strcmp(column, "location") != 0){
+                printf("%s is not an indexed column, use name or location \n", column);
+                continue;
+            }
+            size_t len = strlen(value);
+            bool prefix = len > 0 && value[len - 1] == '*';
+            if (prefix){
+                value[len - 1] = '\0';
+            }
+            rowColumn col = strcmp(column, "name") == 0 ? COLUMN_NAME : COLUMN_LOCATION;
+            struct Row rows[FIND_MAX_ROWS];
+            size_t found = retrieveWhere(dataReader, nameLocationIndex, col, value, prefix, rows, FIND_MAX_ROWS);
+            for (size_t i = 0; i < found && i < FIND_MAX_ROWS; i++){
+                printRow(&rows[i], NULL);
+            }
+            if (found > FIND_MAX_ROWS){
+                printf("... and %zu more \n", found - FIND_MAX_ROWS);
+            }
+            printf("%zu rows matched \n", found);
+            continue;
+        }
+        if (input == 'b'){
+            printf("===== range mode ======= \n");
+            if (idIndex->meta.count == 0){
+                constructTree(dbFile, idIndex);
+            }
+            printf("enter the first and last id \n");
+            int64_t low, high;
+            if (scanf("%ld %ld", &low, &high) != 2){
+                continue;
+            }
+            struct timespec start, end;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            // rows are printed as each batch is read, not after the whole range
+            rangeStats stats = retrieveRange(dbFile, idIndex, low, high, printRow, NULL);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+            printf("%zu rows in %.1fms (%.0f rows/sec), %u pages read in %u reads \n", stats.rows,
+                seconds * 1e3, seconds > 0 ? stats.rows / seconds : 0.0, stats.pages, stats.reads);
+            continue;
+        }
+        if (input == 'g'){
+            printf("===== group mode ======= \n");
+            printf("enter name or location to count rows and get the min, max and sum of id per value \n");
+            char column[16];
+            if (scanf("%15s", column) != 1){
+                continue;
+            }
+            if (strcmp(column, "name") != 0 && strcmp(column, "location") != 0){
+                printf("%s can't be grouped by, use name or location \n", column);
+                continue;
+            }
+            rowColumn col = strcmp(column, "name") == 0 ? COLUMN_NAME : COLUMN_LOCATION;
+            struct timespec start, end;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            mmapReader* reader = mmapReaderOpen(dbFile, MMAP_SEQUENTIAL);
+            aggregateResult result = aggregateBy(reader, col, NULL, 0, aggregateDefaultThreads());
+            mmapReaderClose(reader);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+            printf("%-20s %10s %12s %12s %16s \n", column, "count", "min(id)", "max(id)", "sum(id)");
+            for (size_t i = 0; i < result.numGroups && i < FIND_MAX_ROWS; i++){
+                aggregateGroup* group = &result.groups[i];
+                printf("%-20.64s %10ld %12ld %12ld %16ld \n", group->key, group->count, group->min, group->max, group->sum);
+            }
+            if (result.numGroups > FIND_MAX_ROWS){
+                printf("... and %zu more groups \n", result.numGroups - FIND_MAX_ROWS);
+            }
+            printf("%zu groups from %zu rows in %.1fms (%.0f rows/sec) on %d threads \n", result.numGroups,
+                result.rows, seconds * 1e3, seconds > 0 ? result.rows / seconds : 0.0, result.threads);
+            aggregateResultFree(&result);
+            continue;
+        }
+        if (input == 's'){
+            printf("===== stats ======= \n");
+            pageIndexPrintStats(idIndex);
+            secondaryIndexesPrintStats(nameLocationIndex);
+            bufferPoolPrintStats(pool);
             continue;
         }
         if (input == 'r'){
             printf("===== retrieve mode ======= \n");
-            dbFile = openFile(PATH_TO_DB, "rb");
-            // in retrieve mode we need to create the bTree
-            constructTree(dbFile, tree);
-                        
-            fclose(dbFile);
+            if (idIndex->meta.count == 0){
+                // data file from before the index was persisted
+                constructTree(dbFile, idIndex);
+            }
+            printf("enter an id \n");
+            int64_t id;
+            if (scanf("%ld", &id) == 1){
+                // inserts flush the pool before returning, so the file is current
+                struct Row row;
+                if (retrieve(dataReader, idIndex, id, &row)){
+                    printRow(&row, NULL);
+                }
+                else {
+                    printf("id %ld is not in the db \n", id);
+                }
+            }
+            bufferPoolPrintStats(pool);
         }
         else {
-            printf("Not a valid mode, enter ('r' or 'i') \n");
+            printf("Not a valid mode, enter ('r', 'i', 'f', 'b', 'g' or 's') \n");
         }
 
     }
+    checkpoint(dbFile, pool, idIndex, walLog);
+    walClose(walLog);
+    pageIndexClose(idIndex);
+    secondaryIndexesFree(nameLocationIndex);
+    bufferPoolFlush(pool, dbFile);
+    mmapReaderClose(dataReader);
+    close(dbFile);
+    bufferPoolFree(pool);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,96 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "mmapReader.h"
+#include "page.h"
+
+static void applyAdvice(mmapReader* reader){
+	if (reader->base == NULL){
+		return;
+	}
+	int advice = reader->access == MMAP_SEQUENTIAL ? MADV_SEQUENTIAL : MADV_RANDOM;
+	madvise((void*)reader->base, reader->mappedSize, advice);
+}
+
+mmapReader* mmapReaderOpen(int db, mmapAccess access){
+	mmapReader* reader = malloc(sizeof(mmapReader));
+	if (reader == NULL){
+		printf("error allocating the mmap reader exiting..");
+		exit(1);
+	}
+	reader->fd = db;
+	reader->base = NULL;
+	reader->mappedSize = 0;
+	reader->access = access;
+	mmapReaderRefresh(reader);
+	return reader;
+}
+
+void mmapReaderClose(mmapReader* reader){
+	if (reader->base != NULL){
+		munmap((void*)reader->base, reader->mappedSize);
+	}
+	free(reader);
+}
+
+// Remaps if the file grew since the last map. Only whole pages are mapped, a
+// trailing partial page is picked up once it has been written out in full.
+// Returns true if the mapping changed.
+bool mmapReaderRefresh(mmapReader* reader){
+	struct stat st;
+	if (fstat(reader->fd, &st) != 0){
+		printf("error reading the DB size exiting..");
+		exit(1);
+	}
+	size_t size = (size_t)st.st_size / PAGE_SIZE * PAGE_SIZE;
+	if (size == reader->mappedSize){
+		return false;
+	}
+	if (reader->base != NULL){
+		munmap((void*)reader->base, reader->mappedSize);
+		reader->base = NULL;
+		reader->mappedSize = 0;
+	}
+	if (size == 0){
+		return true;
+	}
+	void* base = mmap(NULL, size, PROT_READ, MAP_SHARED, reader->fd, 0);
+	if (base == MAP_FAILED){
+		printf("error mapping the DB exiting..");
+		exit(1);
+	}
+	reader->base = base;
+	reader->mappedSize = size;
+	applyAdvice(reader);
+	return true;
+}
+
+void mmapReaderAdvise(mmapReader* reader, mmapAccess access){
+	reader->access = access;
+	applyAdvice(reader);
+}
+
+uint32_t mmapReaderPages(const mmapReader* reader){
+	return reader->mappedSize / PAGE_SIZE;
+}
+
+// NULL if the page is past the end of the file
+const char* mmapReaderPage(mmapReader* reader, uint32_t page_id){
+	size_t end = ((size_t)page_id + 1) * PAGE_SIZE;
+	if (end > reader->mappedSize){
+		mmapReaderRefresh(reader);
+		if (end > reader->mappedSize){
+			return NULL;
+		}
+	}
+	return reader->base + (size_t)page_id * PAGE_SIZE;
+}
+
+// copies the row out, a PAX row isn't in one piece in the mapping
+bool mmapReaderGetRow(mmapReader* reader, rowLocator loc, struct Row* dOut){
+	const char* page = mmapReaderPage(reader, loc.page_id);
+	if (page == NULL || (loc.offset & ~PAX_ROW_FLAG) >= PAGE_SIZE){
+		return false;
+	}
+	pageReadRow(page, loc.offset, dOut);
+	return true;
+}
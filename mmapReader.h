@@ -0,0 +1,28 @@
+#pragma once
+#include <stdbool.h>
+#include "db.h"
+
+// Read-only view of dbFile.bin through mmap. Pages are handed back as pointers
+// straight into the mapping, so a read costs no copy and no syscall once the
+// page is resident. Pointers stay valid until the next remap, which only
+// happens when a lookup goes past the end of the current mapping.
+
+typedef enum {
+	MMAP_RANDOM,     // point gets, don't read ahead
+	MMAP_SEQUENTIAL  // full scans, read ahead aggressively
+} mmapAccess;
+
+typedef struct mmapReader {
+	int fd;
+	const char* base;
+	size_t mappedSize;
+	mmapAccess access;
+} mmapReader;
+
+mmapReader* mmapReaderOpen(int db, mmapAccess access);
+void mmapReaderClose(mmapReader* reader);
+bool mmapReaderRefresh(mmapReader* reader);
+void mmapReaderAdvise(mmapReader* reader, mmapAccess access);
+uint32_t mmapReaderPages(const mmapReader* reader);
+const char* mmapReaderPage(mmapReader* reader, uint32_t page_id);
+bool mmapReaderGetRow(mmapReader* reader, rowLocator loc, struct Row* dOut);
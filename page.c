@@ -0,0 +1,128 @@
+#include "page.h"
+
+_Static_assert(PAX_IDS_OFFSET + PAX_ROWS_PER_PAGE * sizeof(int64_t) <= PAX_NAMES_OFFSET,
+	"the id minipage must end before the names start");
+_Static_assert(PAX_LOCATIONS_OFFSET + PAX_ROWS_PER_PAGE * LOCATION_SIZE <= PAGE_SIZE,
+	"the location minipage must fit in the page");
+
+void pageInit(char* page){
+	pageInitFormat(page, DATA_PAGE_FORMAT);
+}
+
+void pageInitFormat(char* page, uint16_t format){
+	memset(page, 0, PAGE_SIZE);
+	pageHeader* header = (pageHeader*)page;
+	header->freeStart = sizeof(pageHeader);
+	header->freeEnd = PAGE_SIZE;
+	header->format = format;
+}
+
+uint16_t pageFormat(const char* page){
+	return ((const pageHeader*)page)->format;
+}
+
+// offset the next row of this length will land at, rows stay 8 byte aligned
+uint16_t pageNextOffset(const char* page, uint16_t length){
+	const pageHeader* header = (const pageHeader*)page;
+	if (header->format == PAGE_FORMAT_PAX){
+		return (PAX_IDS_OFFSET + header->numSlots * sizeof(int64_t)) | PAX_ROW_FLAG;
+	}
+	return (header->freeEnd - length) & ~7;
+}
+
+bool pageHasRoom(const char* page, uint16_t length){
+	const pageHeader* header = (const pageHeader*)page;
+	if (header->format == PAGE_FORMAT_PAX){
+		return length == sizeof(struct Row) && header->numSlots < PAX_ROWS_PER_PAGE;
+	}
+	return header->freeEnd >= length &&
+		pageNextOffset(page, length) >= header->freeStart + sizeof(pageSlot);
+}
+
+// returns the row's offset in the page, or -1 when the page is full
+// PAX pages only hold whole struct Rows, split up into the minipages
+int pageInsertRow(char* page, const void* row, uint16_t length){
+	pageHeader* header = (pageHeader*)page;
+	if (!pageHasRoom(page, length)){
+		return -1;
+	}
+	uint16_t offset = pageNextOffset(page, length);
+	if (header->format == PAGE_FORMAT_PAX){
+		const struct Row* r = row;
+		uint16_t i = header->numSlots;
+		memcpy(page + PAX_IDS_OFFSET + i * sizeof(int64_t), &r->id, sizeof(int64_t));
+		memcpy(page + PAX_NAMES_OFFSET + i * NAME_SIZE, r->name, NAME_SIZE);
+		memcpy(page + PAX_LOCATIONS_OFFSET + i * LOCATION_SIZE, r->location, LOCATION_SIZE);
+		header->numSlots++;
+		return offset;
+	}
+	pageSlot* slot = (pageSlot*)(page + header->freeStart);
+	slot->offset = offset;
+	slot->length = length;
+	memcpy(page + offset, row, length);
+	header->numSlots++;
+	header->freeStart += sizeof(pageSlot);
+	header->freeEnd = offset;
+	return offset;
+}
+
+uint16_t pageNumSlots(const char* page){
+	return ((const pageHeader*)page)->numSlots;
+}
+
+const pageSlot* pageGetSlot(const char* page, uint16_t slot){
+	return (const pageSlot*)(page + sizeof(pageHeader)) + slot;
+}
+
+// the locator offset of the row in this slot, for either format
+uint16_t pageRowOffset(const char* page, uint16_t slot){
+	if (pageFormat(page) == PAGE_FORMAT_PAX){
+		return (PAX_IDS_OFFSET + slot * sizeof(int64_t)) | PAX_ROW_FLAG;
+	}
+	return pageGetSlot(page, slot)->offset;
+}
+
+// one column of the row at offset: an int64_t id, or a name or location string
+const char* pageColumnAt(const char* page, uint16_t offset, rowColumn column){
+	if (offset & PAX_ROW_FLAG){
+		uint16_t i = ((offset & ~PAX_ROW_FLAG) - PAX_IDS_OFFSET) / sizeof(int64_t);
+		switch (column){
+			case COLUMN_ID: return page + PAX_IDS_OFFSET + i * sizeof(int64_t);
+			case COLUMN_NAME: return page + PAX_NAMES_OFFSET + i * NAME_SIZE;
+			case COLUMN_LOCATION: return page + PAX_LOCATIONS_OFFSET + i * LOCATION_SIZE;
+		}
+	}
+	const struct Row* row = (const struct Row*)(page + offset);
+	switch (column){
+		case COLUMN_ID: return (const char*)&row->id;
+		case COLUMN_NAME: return row->name;
+		case COLUMN_LOCATION: return row->location;
+	}
+	return NULL;
+}
+
+// A PAX page's minipage for column, slot i's value starts i * 8 bytes in for
+// ids and i * 64 for names and locations. NULL for slotted pages, whose
+// columns aren't stored together.
+const char* pageColumn(const char* page, rowColumn column){
+	if (pageFormat(page) != PAGE_FORMAT_PAX){
+		return NULL;
+	}
+	switch (column){
+		case COLUMN_ID: return page + PAX_IDS_OFFSET;
+		case COLUMN_NAME: return page + PAX_NAMES_OFFSET;
+		case COLUMN_LOCATION: return page + PAX_LOCATIONS_OFFSET;
+	}
+	return NULL;
+}
+
+// copies the whole row out, PAX rows are put back together from the minipages
+void pageReadRow(const char* page, uint16_t offset, struct Row* dOut){
+	if (offset & PAX_ROW_FLAG){
+		memcpy(&dOut->id, pageColumnAt(page, offset, COLUMN_ID), sizeof(int64_t));
+		memcpy(dOut->name, pageColumnAt(page, offset, COLUMN_NAME), NAME_SIZE);
+		memcpy(dOut->location, pageColumnAt(page, offset, COLUMN_LOCATION), LOCATION_SIZE);
+		return;
+	}
+	memcpy(dOut, page + offset, sizeof(struct Row));
+}
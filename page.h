@@ -0,0 +1,62 @@
+#pragma once
+#include <stdbool.h>
+#include "db.h"
+
+// Slotted page layout used by dbFile.bin:
+//
+//   | pageHeader | slot 0 | slot 1 | ... free space ... | row 1 | row 0 |
+//
+// The slot directory grows forward from the header and rows are packed
+// backward from the end of the page, so a row never crosses a page boundary
+// and (page_id, offset) always resolves with a single page read.
+//
+// Pages can instead use the PAX layout, where each column has its own
+// minipage and a scan that reads one column only touches that column's bytes:
+//
+//   | pageHeader | id 0 | id 1 | ... | name 0 | name 1 | ... | location 0 | location 1 | ... |
+//
+// The id minipage starts right after the header, the name and location
+// minipages start on cache line boundaries. A PAX row's locator offset is the
+// offset of its id with PAX_ROW_FLAG set, so locators keep their shape, still
+// resolve within one page, and tell a reader which layout to expect before it
+// reads the page. Each page records its own format, so a file can hold both
+// and old files read as they always did. New pages use DATA_PAGE_FORMAT.
+
+#define PAGE_FORMAT_SLOTTED 0
+#define PAGE_FORMAT_PAX 1
+#ifndef DATA_PAGE_FORMAT
+#define DATA_PAGE_FORMAT PAGE_FORMAT_SLOTTED // build with -DDATA_PAGE_FORMAT=PAGE_FORMAT_PAX for column scans
+#endif
+
+typedef struct pageHeader {
+	uint16_t numSlots;  // rows on the page, in either format
+	uint16_t freeStart; // first byte after the slot directory
+	uint16_t freeEnd;   // first byte of the row area
+	uint16_t format;    // PAGE_FORMAT_*, 0 in files from before PAX pages
+} pageHeader;
+
+typedef struct pageSlot {
+	uint16_t offset;
+	uint16_t length;
+} pageSlot;
+
+#define ROWS_PER_PAGE ((PAGE_SIZE - sizeof(pageHeader)) / (sizeof(pageSlot) + sizeof(struct Row)))
+
+#define PAX_IDS_OFFSET sizeof(pageHeader)
+#define PAX_NAMES_OFFSET 256
+#define PAX_ROWS_PER_PAGE ((PAGE_SIZE - PAX_NAMES_OFFSET) / (NAME_SIZE + LOCATION_SIZE))
+#define PAX_LOCATIONS_OFFSET (PAX_NAMES_OFFSET + PAX_ROWS_PER_PAGE * NAME_SIZE)
+#define PAX_ROW_FLAG 0x8000 // set in a PAX row's offset, real offsets stay below PAGE_SIZE
+
+void pageInit(char* page);
+void pageInitFormat(char* page, uint16_t format);
+uint16_t pageFormat(const char* page);
+bool pageHasRoom(const char* page, uint16_t length);
+uint16_t pageNextOffset(const char* page, uint16_t length);
+int pageInsertRow(char* page, const void* row, uint16_t length);
+uint16_t pageNumSlots(const char* page);
+const pageSlot* pageGetSlot(const char* page, uint16_t slot);
+uint16_t pageRowOffset(const char* page, uint16_t slot);
+const char* pageColumnAt(const char* page, uint16_t offset, rowColumn column);
+const char* pageColumn(const char* page, rowColumn column);
+void pageReadRow(const char* page, uint16_t offset, struct Row* dOut);
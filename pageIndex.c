@@ -0,0 +1,428 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include "pageIndex.h"
+
+_Static_assert(sizeof(leafPage) <= PAGE_SIZE, "leaf node must fit in a page");
+_Static_assert(sizeof(internalPage) <= PAGE_SIZE, "internal node must fit in a page");
+
+static indexPage* pinPage(pageIndex* index, uint32_t pageNum){
+	return (indexPage*)bufferPoolPin(index->pool, index->fd, pageNum);
+}
+
+static void unpinPage(pageIndex* index, indexPage* page, bool dirty){
+	bufferPoolUnpin(index->pool, page->raw, dirty);
+}
+
+// pins a fresh, zeroed page at the end of the file
+static indexPage* allocPage(pageIndex* index, uint32_t* pageNum){
+	*pageNum = index->meta.numPages++;
+	indexPage* page = pinPage(index, *pageNum);
+	memset(page, 0, PAGE_SIZE);
+	return page;
+}
+
+// a fresh index is the meta page plus an empty leaf as the root
+static void initIndex(pageIndex* index){
+	index->meta.magic = INDEX_MAGIC;
+	index->meta.rootPage = 1;
+	index->meta.height = 1;
+	index->meta.numPages = 1;
+	index->meta.count = 0;
+	index->lastLeaf = 0;
+	uint32_t rootPage;
+	indexPage* root = allocPage(index, &rootPage);
+	root->header.isLeaf = 1;
+	unpinPage(index, root, true);
+	pageIndexFlush(index);
+}
+
+pageIndex* pageIndexOpen(char* filePath, bufferPool* pool){
+	pageIndex* index = malloc(sizeof(pageIndex));
+	if (index == NULL){
+		printf("error allocating the index exiting..");
+		exit(1);
+	}
+	index->pool = pool;
+	index->fd = open(filePath, O_RDWR | O_CREAT, 0644);
+	if (index->fd < 0){
+		printf("error opening the index exiting..");
+		exit(1);
+	}
+	if (lseek(index->fd, 0, SEEK_END) == 0){
+		initIndex(index);
+		return index;
+	}
+	indexPage* page = pinPage(index, 0);
+	memcpy(&index->meta, page->raw, sizeof(indexMeta));
+	unpinPage(index, page, false);
+	index->lastLeaf = 0;
+	if (index->meta.magic != INDEX_MAGIC){
+		printf("%s is not an index file exiting..", filePath);
+		exit(1);
+	}
+	return index;
+}
+
+// the meta page is only written here, so callers flush once per batch of puts
+void pageIndexFlush(pageIndex* index){
+	indexPage* page = pinPage(index, 0);
+	memcpy(page->raw, &index->meta, sizeof(indexMeta));
+	unpinPage(index, page, true);
+	bufferPoolFlush(index->pool, index->fd);
+}
+
+// throws away every entry, used when the file can't be trusted after a crash
+void pageIndexReset(pageIndex* index){
+	bufferPoolDiscard(index->pool, index->fd);
+	if (ftruncate(index->fd, 0) != 0){
+		printf("error truncating the index exiting..");
+		exit(1);
+	}
+	initIndex(index);
+}
+
+void pageIndexClose(pageIndex* index){
+	pageIndexFlush(index);
+	close(index->fd);
+	free(index);
+}
+
+void pageIndexPrintStats(const pageIndex* index){
+	printf("id index: %ld keys, height %u, %u pages (%.1fKB) \n", index->meta.count, index->meta.height,
+		index->meta.numPages, index->meta.numPages * (PAGE_SIZE / 1024.0));
+}
+
+// first slot whose key is >= key
+static int leafSearch(const leafPage* leaf, int64_t key){
+	int low = 0, high = leaf->header.numKeys;
+	while (low < high){
+		int mid = low + (high - low) / 2;
+		if (leaf->keys[mid] < key){
+			low = mid + 1;
+		}
+		else{
+			high = mid;
+		}
+	}
+	return low;
+}
+
+// child to follow, keys[i] is the smallest key under children[i + 1]
+static int internalSearch(const internalPage* node, int64_t key){
+	int low = 0, high = node->header.numKeys;
+	while (low < high){
+		int mid = low + (high - low) / 2;
+		if (node->keys[mid] <= key){
+			low = mid + 1;
+		}
+		else{
+			high = mid;
+		}
+	}
+	return low;
+}
+
+bool pageIndexGet(pageIndex* index, int64_t key, rowLocator* out){
+	indexPage* page = pinPage(index, index->meta.rootPage);
+	while (!page->header.isLeaf){
+		uint32_t child = page->internal.children[internalSearch(&page->internal, key)];
+		unpinPage(index, page, false);
+		page = pinPage(index, child);
+	}
+	int pos = leafSearch(&page->leaf, key);
+	bool found = pos < page->header.numKeys && page->leaf.keys[pos] == key;
+	if (found){
+		*out = page->leaf.values[pos];
+	}
+	unpinPage(index, page, false);
+	return found;
+}
+
+// Calls match for every key in [low, high] in key order: one descent to the
+// leaf that holds low, then along the leaves' next pointers until a key goes
+// past high. Returns the number of keys passed to match.
+size_t pageIndexRange(pageIndex* index, int64_t low, int64_t high, indexRangeFn match, void* arg){
+	if (low > high){
+		return 0;
+	}
+	indexPage* page = pinPage(index, index->meta.rootPage);
+	while (!page->header.isLeaf){
+		uint32_t child = page->internal.children[internalSearch(&page->internal, low)];
+		unpinPage(index, page, false);
+		page = pinPage(index, child);
+	}
+	size_t found = 0;
+	int pos = leafSearch(&page->leaf, low);
+	while (true){
+		for (; pos < page->header.numKeys; pos++){
+			if (page->leaf.keys[pos] > high){
+				unpinPage(index, page, false);
+				return found;
+			}
+			match(page->leaf.keys[pos], page->leaf.values[pos], arg);
+			found++;
+		}
+		uint32_t next = page->header.next;
+		unpinPage(index, page, false);
+		if (next == 0){
+			return found;
+		}
+		page = pinPage(index, next);
+		pos = 0;
+	}
+}
+
+// Splits a full leaf while inserting key at pos. The new right sibling is
+// created in the pool and its first key is returned through sepKey. When the
+// insert lands at the very end of the tree (ascending ids, our normal case)
+// the old leaf is kept full and the new one starts with just the new key, so
+// appends leave packed leaves behind instead of half empty ones.
+static uint32_t splitLeaf(pageIndex* index, indexPage* page, int pos, int64_t key,
+		rowLocator loc, bool rightmost, int64_t* sepKey){
+	int64_t keys[LEAF_MAX_KEYS + 1];
+	rowLocator values[LEAF_MAX_KEYS + 1];
+	int total = page->header.numKeys + 1;
+	memcpy(keys, page->leaf.keys, pos * sizeof(int64_t));
+	memcpy(values, page->leaf.values, pos * sizeof(rowLocator));
+	keys[pos] = key;
+	values[pos] = loc;
+	memcpy(&keys[pos + 1], &page->leaf.keys[pos], (total - 1 - pos) * sizeof(int64_t));
+	memcpy(&values[pos + 1], &page->leaf.values[pos], (total - 1 - pos) * sizeof(rowLocator));
+
+	int split = (rightmost && pos == total - 1) ? total - 1 : total / 2;
+	uint32_t rightPage;
+	indexPage* right = allocPage(index, &rightPage);
+	right->header.isLeaf = 1;
+	right->header.numKeys = total - split;
+	right->header.next = page->header.next;
+	memcpy(right->leaf.keys, &keys[split], (total - split) * sizeof(int64_t));
+	memcpy(right->leaf.values, &values[split], (total - split) * sizeof(rowLocator));
+	*sepKey = right->leaf.keys[0];
+	unpinPage(index, right, true);
+
+	page->header.numKeys = split;
+	page->header.next = rightPage;
+	memcpy(page->leaf.keys, keys, split * sizeof(int64_t));
+	memcpy(page->leaf.values, values, split * sizeof(rowLocator));
+	return rightPage;
+}
+
+// same idea for internal nodes, the middle key moves up instead of being copied
+static uint32_t splitInternal(pageIndex* index, indexPage* page, int pos, int64_t key,
+		uint32_t child, bool rightmost, int64_t* sepKey){
+	int64_t keys[INTERNAL_MAX_KEYS + 1];
+	uint32_t children[INTERNAL_MAX_KEYS + 2];
+	int total = page->header.numKeys + 1;
+	memcpy(keys, page->internal.keys, pos * sizeof(int64_t));
+	memcpy(children, page->internal.children, (pos + 1) * sizeof(uint32_t));
+	keys[pos] = key;
+	children[pos + 1] = child;
+	memcpy(&keys[pos + 1], &page->internal.keys[pos], (total - 1 - pos) * sizeof(int64_t));
+	memcpy(&children[pos + 2], &page->internal.children[pos + 1], (total - 1 - pos) * sizeof(uint32_t));
+
+	int mid = (rightmost && pos == total - 1) ? total - 1 : total / 2;
+	uint32_t rightPage;
+	indexPage* right = allocPage(index, &rightPage);
+	right->header.numKeys = total - mid - 1;
+	memcpy(right->internal.keys, &keys[mid + 1], (total - mid - 1) * sizeof(int64_t));
+	memcpy(right->internal.children, &children[mid + 1], (total - mid) * sizeof(uint32_t));
+	unpinPage(index, right, true);
+
+	page->header.numKeys = mid;
+	memcpy(page->internal.keys, keys, mid * sizeof(int64_t));
+	memcpy(page->internal.children, children, (mid + 1) * sizeof(uint32_t));
+	*sepKey = keys[mid];
+	return rightPage;
+}
+
+// returns 0 on insert, 1 if the key is already indexed
+int pageIndexPut(pageIndex* index, int64_t key, rowLocator loc){
+	// ascending ids go past the end of the rightmost leaf, no descent needed
+	if (index->lastLeaf != 0){
+		indexPage* page = pinPage(index, index->lastLeaf);
+		int numKeys = page->header.numKeys;
+		if (numKeys > 0 && numKeys < (int)LEAF_MAX_KEYS && key > page->leaf.keys[numKeys - 1]){
+			page->leaf.keys[numKeys] = key;
+			page->leaf.values[numKeys] = loc;
+			page->header.numKeys++;
+			unpinPage(index, page, true);
+			index->meta.count++;
+			return 0;
+		}
+		unpinPage(index, page, false);
+	}
+
+	uint32_t path[INDEX_MAX_HEIGHT];
+	int childPos[INDEX_MAX_HEIGHT];
+	int depth = 0;
+	bool rightmost = true;
+	uint32_t pageNum = index->meta.rootPage;
+	indexPage* page = pinPage(index, pageNum);
+	while (!page->header.isLeaf){
+		int pos = internalSearch(&page->internal, key);
+		rightmost = rightmost && pos == page->header.numKeys;
+		path[depth] = pageNum;
+		childPos[depth] = pos;
+		depth++;
+		pageNum = page->internal.children[pos];
+		unpinPage(index, page, false);
+		page = pinPage(index, pageNum);
+	}
+
+	if (rightmost){
+		index->lastLeaf = pageNum;
+	}
+	int pos = leafSearch(&page->leaf, key);
+	int numKeys = page->header.numKeys;
+	if (pos < numKeys && page->leaf.keys[pos] == key){
+		unpinPage(index, page, false);
+		return 1;
+	}
+	index->meta.count++;
+	if (numKeys < (int)LEAF_MAX_KEYS){
+		memmove(&page->leaf.keys[pos + 1], &page->leaf.keys[pos], (numKeys - pos) * sizeof(int64_t));
+		memmove(&page->leaf.values[pos + 1], &page->leaf.values[pos], (numKeys - pos) * sizeof(rowLocator));
+		page->leaf.keys[pos] = key;
+		page->leaf.values[pos] = loc;
+		page->header.numKeys++;
+		unpinPage(index, page, true);
+		return 0;
+	}
+
+	int64_t sepKey;
+	uint32_t newPage = splitLeaf(index, page, pos, key, loc, rightmost, &sepKey);
+	unpinPage(index, page, true);
+	if (rightmost){
+		index->lastLeaf = newPage;
+	}
+
+	// push the separator up the path until some parent has room for it
+	while (depth > 0){
+		depth--;
+		pos = childPos[depth];
+		page = pinPage(index, path[depth]);
+		numKeys = page->header.numKeys;
+		if (numKeys < (int)INTERNAL_MAX_KEYS){
+			memmove(&page->internal.keys[pos + 1], &page->internal.keys[pos], (numKeys - pos) * sizeof(int64_t));
+			memmove(&page->internal.children[pos + 2], &page->internal.children[pos + 1],
+					(numKeys - pos) * sizeof(uint32_t));
+			page->internal.keys[pos] = sepKey;
+			page->internal.children[pos + 1] = newPage;
+			page->header.numKeys++;
+			unpinPage(index, page, true);
+			return 0;
+		}
+		newPage = splitInternal(index, page, pos, sepKey, newPage, rightmost, &sepKey);
+		unpinPage(index, page, true);
+	}
+
+	// the root itself split, grow the tree by one level
+	if (index->meta.height >= INDEX_MAX_HEIGHT){
+		printf("index is too tall exiting..");
+		exit(1);
+	}
+	uint32_t rootPage;
+	page = allocPage(index, &rootPage);
+	page->header.numKeys = 1;
+	page->internal.keys[0] = sepKey;
+	page->internal.children[0] = index->meta.rootPage;
+	page->internal.children[1] = newPage;
+	unpinPage(index, page, true);
+	index->meta.rootPage = rootPage;
+	index->meta.height++;
+	return 0;
+}
+
+void pageIndexBuildStart(indexBuilder* builder, pageIndex* index, double fillFactor){
+	if (index->meta.count != 0){
+		printf("the index has to be empty to bulk load it exiting..");
+		exit(1);
+	}
+	builder->index = index;
+	builder->rightmost[0] = index->meta.rootPage;
+	index->lastLeaf = 0;
+	builder->levels = 1;
+	builder->leafFill = LEAF_MAX_KEYS * fillFactor;
+	builder->internalFill = INTERNAL_MAX_KEYS * fillFactor;
+	if (builder->leafFill < 1){
+		builder->leafFill = 1;
+	}
+	if (builder->internalFill < 1){
+		builder->internalFill = 1;
+	}
+}
+
+// left was the rightmost node on the level below until right was started
+static void pushSeparator(indexBuilder* builder, int level, int64_t key, uint32_t left, uint32_t right){
+	pageIndex* index = builder->index;
+	uint32_t pageNum;
+	if (level == builder->levels){
+		if (level >= INDEX_MAX_HEIGHT){
+			printf("index is too tall exiting..");
+			exit(1);
+		}
+		indexPage* root = allocPage(index, &pageNum);
+		root->header.numKeys = 1;
+		root->internal.keys[0] = key;
+		root->internal.children[0] = left;
+		root->internal.children[1] = right;
+		unpinPage(index, root, true);
+		builder->rightmost[level] = pageNum;
+		builder->levels++;
+		index->meta.rootPage = pageNum;
+		index->meta.height = builder->levels;
+		return;
+	}
+	indexPage* node = pinPage(index, builder->rightmost[level]);
+	int numKeys = node->header.numKeys;
+	if (numKeys < builder->internalFill){
+		node->internal.keys[numKeys] = key;
+		node->internal.children[numKeys + 1] = right;
+		node->header.numKeys++;
+		unpinPage(index, node, true);
+		return;
+	}
+	unpinPage(index, node, false);
+	// this node is full, start a new one whose first child is right and move
+	// the key up a level instead
+	indexPage* fresh = allocPage(index, &pageNum);
+	fresh->internal.children[0] = right;
+	unpinPage(index, fresh, true);
+	uint32_t full = builder->rightmost[level];
+	builder->rightmost[level] = pageNum;
+	pushSeparator(builder, level + 1, key, full, pageNum);
+}
+
+// returns false, adding nothing, if key is not above every key added so far
+bool pageIndexBuildAdd(indexBuilder* builder, int64_t key, rowLocator loc){
+	pageIndex* index = builder->index;
+	if (index->meta.count > 0 && key <= builder->lastKey){
+		return false;
+	}
+	indexPage* leaf = pinPage(index, builder->rightmost[0]);
+	if (leaf->header.numKeys >= builder->leafFill){
+		uint32_t pageNum;
+		indexPage* fresh = allocPage(index, &pageNum);
+		fresh->header.isLeaf = 1;
+		leaf->header.next = pageNum;
+		unpinPage(index, leaf, true);
+		leaf = fresh;
+		uint32_t full = builder->rightmost[0];
+		builder->rightmost[0] = pageNum;
+		pushSeparator(builder, 1, key, full, pageNum);
+	}
+	int numKeys = leaf->header.numKeys;
+	leaf->leaf.keys[numKeys] = key;
+	leaf->leaf.values[numKeys] = loc;
+	leaf->header.numKeys++;
+	unpinPage(index, leaf, true);
+	index->meta.count++;
+	builder->lastKey = key;
+	return true;
+}
+
+// the index is a normal tree again after this, pageIndexPut() works on it
+void pageIndexBuildFinish(indexBuilder* builder){
+	builder->index->lastLeaf = builder->rightmost[0];
+	pageIndexFlush(builder->index);
+}
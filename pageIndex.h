@@ -0,0 +1,84 @@
+#pragma once
+#include <stdbool.h>
+#include "db.h"
+#include "bufferPool.h"
+
+#define PATH_TO_INDEX "index.bin"
+#define INDEX_MAGIC 0x58444e49 // "INDX"
+#define INDEX_MAX_HEIGHT 32
+#define INDEX_BULK_FILL 1.0 // ids only ever arrive at the right edge, so packed nodes don't split later
+
+// The index lives in its own file made of PAGE_SIZE pages. Page 0 is the meta
+// page, every other page is one tree node. Nodes point at each other by page
+// number (never by memory address) so the file can be reopened as is.
+
+typedef struct indexMeta {
+	uint32_t magic;
+	uint32_t rootPage;
+	uint32_t height;
+	uint32_t numPages; // pages in the file, including the meta page
+	int64_t count;
+} indexMeta;
+
+typedef struct indexNodeHeader {
+	uint16_t isLeaf;
+	uint16_t numKeys;
+	uint32_t next; // next leaf to the right, 0 means none (page 0 is the meta page)
+} indexNodeHeader;
+
+#define LEAF_MAX_KEYS ((PAGE_SIZE - sizeof(indexNodeHeader)) / (sizeof(int64_t) + sizeof(rowLocator)))
+#define INTERNAL_MAX_KEYS \
+	((PAGE_SIZE - sizeof(indexNodeHeader) - sizeof(uint32_t)) / (sizeof(int64_t) + sizeof(uint32_t)))
+
+typedef struct leafPage {
+	indexNodeHeader header;
+	int64_t keys[LEAF_MAX_KEYS];
+	rowLocator values[LEAF_MAX_KEYS];
+} leafPage;
+
+typedef struct internalPage {
+	indexNodeHeader header;
+	int64_t keys[INTERNAL_MAX_KEYS];
+	uint32_t children[INTERNAL_MAX_KEYS + 1];
+} internalPage;
+
+typedef union indexPage {
+	indexNodeHeader header;
+	leafPage leaf;
+	internalPage internal;
+	char raw[PAGE_SIZE];
+} indexPage;
+
+typedef struct pageIndex {
+	int fd;
+	bufferPool* pool;
+	indexMeta meta;
+	uint32_t lastLeaf; // rightmost leaf for the append fast path, 0 until a put finds it
+} pageIndex;
+
+// Builds an empty index bottom-up from keys that arrive in ascending order.
+// Only the rightmost node of each level is ever touched: leaves are filled
+// left to right and each new node's first key is pushed into the level above,
+// so a build is linear in the number of keys.
+typedef struct indexBuilder {
+	pageIndex* index;
+	uint32_t rightmost[INDEX_MAX_HEIGHT]; // node being filled on each level, 0 is the leaves
+	int levels;
+	int leafFill;
+	int internalFill;
+	int64_t lastKey;
+} indexBuilder;
+
+typedef void (*indexRangeFn)(int64_t key, rowLocator loc, void* arg);
+
+pageIndex* pageIndexOpen(char* filePath, bufferPool* pool);
+void pageIndexFlush(pageIndex* index);
+void pageIndexReset(pageIndex* index);
+void pageIndexClose(pageIndex* index);
+void pageIndexPrintStats(const pageIndex* index);
+bool pageIndexGet(pageIndex* index, int64_t key, rowLocator* out);
+size_t pageIndexRange(pageIndex* index, int64_t low, int64_t high, indexRangeFn match, void* arg);
+int pageIndexPut(pageIndex* index, int64_t key, rowLocator loc);
+void pageIndexBuildStart(indexBuilder* builder, pageIndex* index, double fillFactor);
+bool pageIndexBuildAdd(indexBuilder* builder, int64_t key, rowLocator loc);
+void pageIndexBuildFinish(indexBuilder* builder);
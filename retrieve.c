@@ -1,64 +1,193 @@
+#include <unistd.h>
 #include "retrieve.h"
 
-bptree * tree;
+// copied out of the mapping, a PAX row is put back together from its page
+static void readRow(mmapReader* reader, rowLocator loc, struct Row* dOut){
+	if (!mmapReaderGetRow(reader, loc, dOut)){
+		printf("error reading the row at page %u exiting.. \n", loc.page_id);
+		exit(1);
+	}
+}
 
+typedef struct scanTarget {
+	struct Row* rows;
+	size_t maxRows;
+	size_t numRows;
+} scanTarget;
 
-static record_t* create_record(const bptree_key_t id, uint32_t page_id, uint32_t offset) {
-    record_t* rec = malloc(sizeof(record_t));
-    if (!rec) {
-        perror("Failed to allocate memory for record");
-        return NULL;
-    }
+// keeps rows until there are maxRows of them, then ends the scan
+static bool keepRows(const scanBatch* batch, const uint16_t* selected, uint32_t numSelected, void* arg){
+	scanTarget* target = arg;
+	for (uint32_t i = 0; i < numSelected && target->numRows < target->maxRows; i++){
+		scanBatchRow(batch, selected[i], &target->rows[target->numRows++]);
+	}
+	return target->numRows < target->maxRows;
+}
 
-	rec->id = id;
-	rec->page_id = page_id;
-	rec->offset = offset;
-    return rec;
+// the reader is advised for point reads, a scan wants read ahead while it runs
+static void scanWithReadAhead(mmapReader* reader, const scanPredicate* predicate, scanTarget* target){
+	mmapAccess access = reader->access;
+	mmapReaderAdvise(reader, MMAP_SEQUENTIAL);
+	scanFilter(reader, predicate, 1, keepRows, target);
+	mmapReaderAdvise(reader, access);
 }
 
-static int record_compare(const bptree_key_t* a, const bptree_key_t* b) {
-    // Assumes BPTREE_NUMERIC_TYPE is defined (default is int64_t)
-    return (*a < *b) ? -1 : ((*a > *b) ? 1 : 0);
+// only used when there is no index, a vectorized scan that stops at the id
+static bool scanForRow(mmapReader* reader, int64_t key, struct Row* dOut){
+	scanPredicate predicate = {SCAN_ID_RANGE, COLUMN_ID, NULL, key, key};
+	scanTarget target = {dOut, 1, 0};
+	scanWithReadAhead(reader, &predicate, &target);
+	return target.numRows > 0;
 }
-static void print_key(const bptree_key_t key) {
-    printf("%lld", (long long)key);  // Use %lld for int64_t
+
+// Looks the id up in the index and copies just that row out of the mapping,
+// so a lookup costs the index height plus, once the page is resident, no
+// syscall at all. Falls back to a full scan when index is NULL.
+bool retrieve(mmapReader* reader, pageIndex* index, int64_t key, struct Row* dOut){
+	if (index == NULL){
+		return scanForRow(reader, key, dOut);
+	}
+	rowLocator loc;
+	if (!pageIndexGet(index, key, &loc)){
+		return false;
+	}
+	readRow(reader, loc, dOut);
+	return true;
 }
 
-void readInBtree(FILE* bTreePath){
-	fread(tree, sizeof(struct bptree), 1, bTreePath);
+// only used when there are no secondary indexes, a vectorized scan that stops
+// once maxRows rows have matched
+static size_t scanWhere(mmapReader* reader, rowColumn column, const char* value, bool prefix, struct Row* dOut,
+	size_t maxRows){
+	scanPredicate predicate = {prefix ? SCAN_PREFIX : SCAN_EQUALS, column, value, 0, 0};
+	scanTarget target = {dOut, maxRows, 0};
+	scanWithReadAhead(reader, &predicate, &target);
+	return target.numRows;
 }
 
-void retrieve(FILE* db, record_t * dOut, bptree_key_t key){
-// check if in bptree first
-	
-// read from Db
-while(fread(dOut, sizeof(struct record_t*), 1, db)){
-        if ( dOut->id == key){
-            printf("found row: %ld, %s, %s \n", dOut->id, dOut->offset, dOut->page_id);
-        }
+typedef struct whereTarget {
+	mmapReader* reader;
+	struct Row* rows;
+	size_t maxRows;
+	size_t numRows;
+} whereTarget;
+
+static void readMatch(int64_t id, rowLocator loc, void* arg){
+	(void)id;
+	whereTarget* target = arg;
+	if (target->numRows < target->maxRows){
+		readRow(target->reader, loc, &target->rows[target->numRows]);
 	}
+	target->numRows++;
 }
 
-int main(int argc, char * argv[]){
-	if (argc < 2){
-		printf("program Usage : ./retrieve id");
-		exit(1);
+// Finds the rows whose name or location equals value (or starts with it when
+// prefix is set). Up to maxRows of them are read into dOut, the return value
+// counts them all. With the secondary indexes this is one probe plus a copy
+// out of the mapping per row read back.
+// Falls back to a scan when secondary is NULL, which ends at the maxRows'th
+// match, so the count it returns is never more than maxRows.
+size_t retrieveWhere(mmapReader* reader, secondaryIndexes* secondary, rowColumn column, const char* value,
+	bool prefix, struct Row* dOut, size_t maxRows){
+	if (secondary == NULL){
+		return scanWhere(reader, column, value, prefix, dOut, maxRows);
 	}
+	whereTarget target = {reader, dOut, maxRows, 0};
+	secondaryIndexFind(secondary, column, value, prefix, readMatch, &target);
+	return target.numRows;
+}
+
+typedef struct rangeEntry {
+	rowLocator loc;
+	uint32_t seq; // position in id order, so rows sharing a page keep it
+} rangeEntry;
+
+typedef struct rangeReader {
+	int db;
+	rangeRowFn emit;
+	void* arg;
+	rangeEntry locs[RANGE_BATCH_ROWS];
+	size_t numLocs;
+	char* run; // RANGE_MAX_RUN_PAGES pages
+	rangeStats stats;
+} rangeReader;
 
-    bptree_key_t id = strtol(argv[1], NULL, 10);
-    printf("ID we are attempting to get : %ld \n", id);
-
-	// record_t * retrievalRow = malloc(sizeof(record_t));
-	record_t * retrievalRow = NULL;
-	// try and get the index / Btree first
-	// tree = bptree_create(4, record_compare, true);
-	// FILE* bTreeFile = openFile("outFile.bin", "rb");
-
-	// readInBtree(bTreeFile);	
-	printf("tree count : %d \n : ", tree->height);
-	
-	FILE* dbRead = openFile(PATH_TO_DB, "rb");
-    
-	retrieve(dbRead, retrievalRow, id);
-	return 0;
-}
\ No newline at end of file
+// by page, and in id order within a page
+static int compareEntries(const void* a, const void* b){
+	const rangeEntry* x = a;
+	const rangeEntry* y = b;
+	if (x->loc.page_id != y->loc.page_id){
+		return x->loc.page_id < y->loc.page_id ? -1 : 1;
+	}
+	return (x->seq > y->seq) - (x->seq < y->seq);
+}
+
+// Reads the rows of the gathered locators in page order. Locators on the same
+// or the next page join the current run, so rows that sit together in the file
+// come back with one sequential read instead of one pread each.
+static void readRangeBatch(rangeReader* reader){
+	qsort(reader->locs, reader->numLocs, sizeof(rangeEntry), compareEntries);
+	size_t i = 0;
+	while (i < reader->numLocs){
+		uint32_t first = reader->locs[i].loc.page_id;
+		uint32_t last = first;
+		size_t end = i;
+		while (end < reader->numLocs && reader->locs[end].loc.page_id <= last + 1
+			&& reader->locs[end].loc.page_id - first < RANGE_MAX_RUN_PAGES){
+			last = reader->locs[end].loc.page_id;
+			end++;
+		}
+		size_t bytes = (size_t)(last - first + 1) * PAGE_SIZE;
+		if (pread(reader->db, reader->run, bytes, (off_t)first * PAGE_SIZE) != (ssize_t)bytes){
+			printf("error reading pages %u to %u exiting.. \n", first, last);
+			exit(1);
+		}
+		reader->stats.reads++;
+		reader->stats.pages += last - first + 1;
+		for (; i < end; i++){
+			const rowLocator* loc = &reader->locs[i].loc;
+			struct Row row;
+			pageReadRow(reader->run + (size_t)(loc->page_id - first) * PAGE_SIZE, loc->offset, &row);
+			reader->emit(&row, reader->arg);
+		}
+	}
+	reader->stats.rows += reader->numLocs;
+	reader->numLocs = 0;
+}
+
+static void gatherLocator(int64_t id, rowLocator loc, void* arg){
+	(void)id;
+	rangeReader* reader = arg;
+	reader->locs[reader->numLocs].loc = loc;
+	reader->locs[reader->numLocs].seq = reader->numLocs;
+	reader->numLocs++;
+	if (reader->numLocs == RANGE_BATCH_ROWS){
+		readRangeBatch(reader);
+	}
+}
+
+// Hands every row with an id in [low, high] to emit. The index's leaf chain
+// gives the locators in id order, RANGE_BATCH_ROWS at a time, and each batch
+// is read back in file order with adjacent pages merged, so rows stream out as
+// each batch is read. Ids are appended in ascending order, so file order and
+// id order normally agree.
+rangeStats retrieveRange(int db, pageIndex* index, int64_t low, int64_t high, rangeRowFn emit, void* arg){
+	rangeReader* reader = malloc(sizeof(rangeReader));
+	char* run = malloc((size_t)RANGE_MAX_RUN_PAGES * PAGE_SIZE);
+	if (reader == NULL || run == NULL){
+		printf("error allocating the range reader exiting..");
+		exit(1);
+	}
+	reader->db = db;
+	reader->emit = emit;
+	reader->arg = arg;
+	reader->numLocs = 0;
+	reader->run = run;
+	memset(&reader->stats, 0, sizeof(rangeStats));
+	pageIndexRange(index, low, high, gatherLocator, reader);
+	readRangeBatch(reader);
+	rangeStats stats = reader->stats;
+	free(run);
+	free(reader);
+	return stats;
+}
@@ -1,14 +1,25 @@
-#define BPTREE_VALUE_TYPE struct record*  // Configure tree to store pointers to records
 #pragma once
+#include <stdbool.h>
 #include "db.h"
-#include "bptree.h"
-#define BPTREE_IMPLEMENTATION
+#include "page.h"
+#include "mmapReader.h"
+#include "pageIndex.h"
+#include "secondaryIndex.h"
+#include "scan.h"
 
-typedef struct record {
-    /** @brief The numeric key used for indexing in the B+ tree. */
-    int64_t id;
-	uint32_t page_id;
-	uint32_t offset;
-} record_t;
+#define RANGE_BATCH_ROWS 4096 // locators taken from the index before their rows are read
+#define RANGE_MAX_RUN_PAGES 32 // adjacent data pages merged into one read, 128KB
 
-// void retrieve(FILE* db, struct record_t * dOut, long key);
+typedef void (*rangeRowFn)(const struct Row* row, void* arg);
+
+typedef struct rangeStats {
+	size_t rows;
+	uint32_t pages; // data pages read
+	uint32_t reads; // preads issued, each one a run of adjacent pages
+} rangeStats;
+
+// retrieve and retrieveWhere copy rows out of a reader opened with MMAP_RANDOM
+bool retrieve(mmapReader* reader, pageIndex* index, int64_t key, struct Row* dOut);
+size_t retrieveWhere(mmapReader* reader, secondaryIndexes* secondary, rowColumn column, const char* value,
+	bool prefix, struct Row* dOut, size_t maxRows);
+rangeStats retrieveRange(int db, pageIndex* index, int64_t low, int64_t high, rangeRowFn emit, void* arg);
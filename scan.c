@@ -0,0 +1,351 @@
+#include "scan.h"
+#include "page.h"
+#include "mmapReader.h"
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
+#define SCAN_WORDS (SCAN_BATCH_ROWS / 64)
+
+_Static_assert(NAME_SIZE == 64 && LOCATION_SIZE == 64, "string compares work on 64 byte fields");
+
+// a predicate with its value padded out to a whole field
+typedef struct compiledPredicate {
+	scanOp op;
+	rowColumn column;
+	char value[64];
+	uint64_t need;     // bit i set if byte i of the field has to equal value[i]
+	uint64_t head;     // the value's first eight bytes, masked by headMask
+	uint64_t headMask; // the bytes of the first eight that have to match
+	int64_t low;
+	int64_t high;
+} compiledPredicate;
+
+// The first eight bytes of every name and location in the batch, gathered only
+// for the columns a string predicate looks at. Comparing these rules out
+// nearly every row four at a time, whole fields are only compared for the rows
+// that get past it and only when the value is longer than eight bytes.
+typedef struct scanHeads {
+	bool wanted[2]; // by column, COLUMN_NAME and COLUMN_LOCATION
+	uint64_t words[2][SCAN_BATCH_ROWS];
+} scanHeads;
+
+// bit i is set if field[i] == value[i]
+typedef uint64_t (*byteEqualFn)(const char* field, const char* value);
+// bit i of bits is set if low <= ids[i] <= high, n is a multiple of 64
+typedef void (*idRangeFn)(const int64_t* ids, uint32_t n, int64_t low, int64_t high, uint64_t* bits);
+// bit i of bits is set if (words[i] & mask) == value, n is a multiple of 64
+typedef void (*headEqualFn)(const uint64_t* words, uint32_t n, uint64_t value, uint64_t mask, uint64_t* bits);
+
+static uint64_t byteEqualScalar(const char* field, const char* value){
+	uint64_t mask = 0;
+	for (int i = 0; i < 64; i++){
+		if (field[i] == value[i]){
+			mask |= 1ULL << i;
+		}
+	}
+	return mask;
+}
+
+static void idRangeScalar(const int64_t* ids, uint32_t n, int64_t low, int64_t high, uint64_t* bits){
+	for (uint32_t w = 0; w < n / 64; w++){
+		uint64_t word = 0;
+		for (int i = 0; i < 64; i++){
+			int64_t id = ids[w * 64 + i];
+			word |= (uint64_t)(id >= low && id <= high) << i;
+		}
+		bits[w] = word;
+	}
+}
+
+static void headEqualScalar(const uint64_t* words, uint32_t n, uint64_t value, uint64_t mask, uint64_t* bits){
+	for (uint32_t w = 0; w < n / 64; w++){
+		uint64_t word = 0;
+		for (int i = 0; i < 64; i++){
+			word |= (uint64_t)((words[w * 64 + i] & mask) == value) << i;
+		}
+		bits[w] = word;
+	}
+}
+
+#ifdef __x86_64__
+// SSE2 is part of x86-64, so these need no check
+static uint64_t byteEqualSse2(const char* field, const char* value){
+	uint64_t mask = 0;
+	for (int i = 0; i < 4; i++){
+		__m128i a = _mm_loadu_si128((const __m128i*)(field + 16 * i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(value + 16 * i));
+		mask |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) << (16 * i);
+	}
+	return mask;
+}
+
+__attribute__((target("avx2")))
+static uint64_t byteEqualAvx2(const char* field, const char* value){
+	__m256i low = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)field),
+		_mm256_loadu_si256((const __m256i*)value));
+	__m256i high = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(field + 32)),
+		_mm256_loadu_si256((const __m256i*)(value + 32)));
+	return (uint64_t)(uint32_t)_mm256_movemask_epi8(low) | (uint64_t)(uint32_t)_mm256_movemask_epi8(high) << 32;
+}
+
+// four ids per compare: an id is out of range if low > id or id > high
+__attribute__((target("avx2")))
+static void idRangeAvx2(const int64_t* ids, uint32_t n, int64_t low, int64_t high, uint64_t* bits){
+	const __m256i lowBound = _mm256_set1_epi64x(low);
+	const __m256i highBound = _mm256_set1_epi64x(high);
+	for (uint32_t w = 0; w < n / 64; w++){
+		uint64_t word = 0;
+		for (int i = 0; i < 64; i += 4){
+			__m256i v = _mm256_loadu_si256((const __m256i*)(ids + w * 64 + i));
+			__m256i out = _mm256_or_si256(_mm256_cmpgt_epi64(lowBound, v), _mm256_cmpgt_epi64(v, highBound));
+			word |= (uint64_t)(~_mm256_movemask_pd(_mm256_castsi256_pd(out)) & 0xf) << i;
+		}
+		bits[w] = word;
+	}
+}
+
+__attribute__((target("avx2")))
+static void headEqualAvx2(const uint64_t* words, uint32_t n, uint64_t value, uint64_t mask, uint64_t* bits){
+	const __m256i want = _mm256_set1_epi64x(value);
+	const __m256i keep = _mm256_set1_epi64x(mask);
+	for (uint32_t w = 0; w < n / 64; w++){
+		uint64_t word = 0;
+		for (int i = 0; i < 64; i += 4){
+			__m256i v = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(words + w * 64 + i)), keep);
+			word |= (uint64_t)_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(v, want))) << i;
+		}
+		bits[w] = word;
+	}
+}
+#endif
+
+// picked per scan rather than kept in globals, so scans can run on several
+// threads at once
+typedef struct scanKernels {
+	byteEqualFn byteEqual;
+	idRangeFn idRange;
+	headEqualFn headEqual;
+} scanKernels;
+
+static bool simdEnabled = true;
+
+static void pickKernels(scanKernels* kernels){
+	kernels->byteEqual = byteEqualScalar;
+	kernels->idRange = idRangeScalar;
+	kernels->headEqual = headEqualScalar;
+#ifdef __x86_64__
+	if (!simdEnabled){
+		return;
+	}
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")){
+		kernels->byteEqual = byteEqualAvx2;
+		kernels->idRange = idRangeAvx2;
+		kernels->headEqual = headEqualAvx2;
+	}
+	else{
+		kernels->byteEqual = byteEqualSse2;
+	}
+#endif
+}
+
+// only for benchmarking the scalar kernels against the SIMD ones
+void scanUseSimd(bool enable){
+	simdEnabled = enable;
+}
+
+// Equality has to match the value and the zero byte after it (unless the
+// value fills the field), a prefix only the value's own bytes.
+static void compilePredicate(const scanPredicate* predicate, compiledPredicate* out){
+	memset(out, 0, sizeof(compiledPredicate));
+	out->op = predicate->op;
+	out->column = predicate->column;
+	out->low = predicate->low;
+	out->high = predicate->high;
+	if (predicate->op == SCAN_ID_RANGE){
+		return;
+	}
+	size_t len = strnlen(predicate->value, sizeof(out->value));
+	memcpy(out->value, predicate->value, len);
+	size_t bytes = predicate->op == SCAN_EQUALS && len < sizeof(out->value) ? len + 1 : len;
+	out->need = bytes == 64 ? ~0ULL : (1ULL << bytes) - 1;
+	// the head words are loaded with memcpy, so byte i is byte i of the field
+	// whatever the endianness and the mask can be built the same way
+	char mask[8];
+	for (int i = 0; i < 8; i++){
+		mask[i] = (out->need >> i) & 1 ? (char)0xff : 0;
+	}
+	memcpy(&out->headMask, mask, sizeof(uint64_t));
+	memcpy(&out->head, out->value, sizeof(uint64_t));
+	out->head &= out->headMask;
+}
+
+// Narrows the selection down to the rows that pass. Id ranges and head words
+// are compared for the whole batch in one go, whole fields only for rows that
+// are still selected.
+static void applyPredicate(const scanKernels* kernels, const compiledPredicate* predicate, const scanBatch* batch,
+	const scanHeads* heads, uint64_t* selection){
+	uint64_t bits[SCAN_WORDS];
+	uint32_t n = (batch->numRows + 63) & ~63u;
+	if (predicate->op == SCAN_ID_RANGE){
+		kernels->idRange(batch->ids, n, predicate->low, predicate->high, bits);
+	}
+	else{
+		kernels->headEqual(heads->words[predicate->column], n, predicate->head, predicate->headMask, bits);
+	}
+	for (uint32_t w = 0; w < n / 64; w++){
+		selection[w] &= bits[w];
+	}
+	if (predicate->op == SCAN_ID_RANGE || (predicate->need >> 8) == 0){
+		return;
+	}
+	const char* const* fields = predicate->column == COLUMN_NAME ? batch->names : batch->locations;
+	for (uint32_t w = 0; w < n / 64; w++){
+		uint64_t word = selection[w];
+		uint64_t pass = 0;
+		while (word){
+			int bit = __builtin_ctzll(word);
+			word &= word - 1;
+			uint64_t equal = kernels->byteEqual(fields[w * 64 + bit], predicate->value);
+			pass |= (uint64_t)((equal & predicate->need) == predicate->need) << bit;
+		}
+		selection[w] = pass;
+	}
+}
+
+// Appends count rows of a page to the batch, starting at slot first. Slotted
+// rows are read through their slots, PAX rows straight off the minipages.
+static void gatherRows(scanBatch* batch, scanHeads* heads, const char* page, uint32_t page_id,
+	uint16_t first, uint16_t count){
+	uint32_t n = batch->numRows;
+	if (pageFormat(page) == PAGE_FORMAT_PAX){
+		const char* names = pageColumn(page, COLUMN_NAME);
+		const char* locations = pageColumn(page, COLUMN_LOCATION);
+		memcpy(&batch->ids[n], pageColumn(page, COLUMN_ID) + first * sizeof(int64_t), count * sizeof(int64_t));
+		for (uint16_t i = first; i < first + count; i++, n++){
+			batch->names[n] = names + i * NAME_SIZE;
+			batch->locations[n] = locations + i * LOCATION_SIZE;
+			batch->locs[n] = (rowLocator){page_id, (PAX_IDS_OFFSET + i * sizeof(int64_t)) | PAX_ROW_FLAG};
+		}
+	}
+	else{
+		for (uint16_t i = first; i < first + count; i++, n++){
+			uint16_t offset = pageGetSlot(page, i)->offset;
+			const struct Row* row = (const struct Row*)(page + offset);
+			batch->ids[n] = row->id;
+			batch->names[n] = row->name;
+			batch->locations[n] = row->location;
+			batch->locs[n] = (rowLocator){page_id, offset};
+		}
+	}
+	for (int column = COLUMN_NAME; column <= COLUMN_LOCATION; column++){
+		if (!heads->wanted[column]){
+			continue;
+		}
+		const char* const* fields = column == COLUMN_NAME ? batch->names : batch->locations;
+		for (uint32_t i = batch->numRows; i < n; i++){
+			memcpy(&heads->words[column][i], fields[i], sizeof(uint64_t));
+		}
+	}
+	batch->numRows = n;
+}
+
+// Runs the predicates over a full (or the last) batch and hands the rows that
+// passed to emit. Returns how many passed, more is cleared if emit asked to stop.
+static uint32_t filterBatch(const scanKernels* kernels, scanBatch* batch, const scanHeads* heads,
+	const compiledPredicate* predicates, int numPredicates, scanEmitFn emit, void* arg, bool* more){
+	uint64_t selection[SCAN_WORDS] = {0};
+	for (uint32_t w = 0; w < batch->numRows / 64; w++){
+		selection[w] = ~0ULL;
+	}
+	if (batch->numRows % 64){
+		selection[batch->numRows / 64] = (1ULL << (batch->numRows % 64)) - 1;
+	}
+	// ids past numRows are left over from the last batch, the mask above drops them
+	for (int p = 0; p < numPredicates; p++){
+		applyPredicate(kernels, &predicates[p], batch, heads, selection);
+	}
+	uint16_t selected[SCAN_BATCH_ROWS];
+	uint32_t numSelected = 0;
+	for (uint32_t w = 0; w < SCAN_WORDS; w++){
+		uint64_t word = selection[w];
+		while (word){
+			selected[numSelected++] = w * 64 + __builtin_ctzll(word);
+			word &= word - 1;
+		}
+	}
+	if (numSelected > 0 && !emit(batch, selected, numSelected, arg)){
+		*more = false;
+	}
+	batch->numRows = 0;
+	return numSelected;
+}
+
+// Calls emit with every batch that has rows passing all the predicates (all
+// rows if there are none), in file order, for pages first up to but not
+// including end, until emit returns false. Returns the number of rows passed.
+// Page ranges that don't overlap can be scanned from different threads with
+// the same reader.
+size_t scanFilterPages(mmapReader* reader, uint32_t first, uint32_t end, const scanPredicate* predicates,
+	int numPredicates, scanEmitFn emit, void* arg){
+	scanKernels kernels;
+	pickKernels(&kernels);
+	compiledPredicate* compiled = malloc((numPredicates + 1) * sizeof(compiledPredicate));
+	scanBatch* batch = malloc(sizeof(scanBatch));
+	scanHeads* heads = malloc(sizeof(scanHeads));
+	if (compiled == NULL || batch == NULL || heads == NULL){
+		printf("error allocating the scan exiting..");
+		exit(1);
+	}
+	// the kernels read whole words of the batch, so the tail has to be readable
+	memset(batch, 0, sizeof(scanBatch));
+	memset(heads, 0, sizeof(scanHeads));
+	for (int p = 0; p < numPredicates; p++){
+		compilePredicate(&predicates[p], &compiled[p]);
+		if (predicates[p].op != SCAN_ID_RANGE){
+			heads->wanted[predicates[p].column] = true;
+		}
+	}
+	size_t found = 0;
+	bool more = true;
+	if (end > mmapReaderPages(reader)){
+		end = mmapReaderPages(reader);
+	}
+	for (uint32_t page_id = first; page_id < end && more; page_id++){
+		const char* page = mmapReaderPage(reader, page_id);
+		uint16_t numRows = pageNumSlots(page);
+		uint16_t slot = 0;
+		while (slot < numRows && more){
+			uint16_t count = numRows - slot;
+			if (count > SCAN_BATCH_ROWS - batch->numRows){
+				count = SCAN_BATCH_ROWS - batch->numRows;
+			}
+			gatherRows(batch, heads, page, page_id, slot, count);
+			slot += count;
+			if (batch->numRows == SCAN_BATCH_ROWS){
+				found += filterBatch(&kernels, batch, heads, compiled, numPredicates, emit, arg, &more);
+			}
+		}
+	}
+	if (batch->numRows > 0 && more){
+		found += filterBatch(&kernels, batch, heads, compiled, numPredicates, emit, arg, &more);
+	}
+	free(heads);
+	free(batch);
+	free(compiled);
+	return found;
+}
+
+// scanFilterPages over the whole file. The reader is left open so repeated
+// scans don't map and fault the file in again each time.
+size_t scanFilter(mmapReader* reader, const scanPredicate* predicates, int numPredicates, scanEmitFn emit,
+	void* arg){
+	return scanFilterPages(reader, 0, mmapReaderPages(reader), predicates, numPredicates, emit, arg);
+}
+
+void scanBatchRow(const scanBatch* batch, uint16_t i, struct Row* dOut){
+	dOut->id = batch->ids[i];
+	memcpy(dOut->name, batch->names[i], NAME_SIZE);
+	memcpy(dOut->location, batch->locations[i], LOCATION_SIZE);
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <stdbool.h>
+#include "db.h"
+#include "mmapReader.h"
+
+#define SCAN_BATCH_ROWS 1024
+
+// Vectorized filter scan over dbFile.bin. Pages are read through an mmap
+// reader (opened with MMAP_SEQUENTIAL) and their rows gathered SCAN_BATCH_ROWS at a time: the ids are copied
+// into one array, names and locations stay where they are and the batch keeps
+// pointers to them. Each predicate then sets one bit per row in the batch's
+// selection bitmap, with SIMD compares of four ids or a whole 64 byte string
+// at a time, and only rows whose bit survives every predicate are passed on.
+// Works on slotted and PAX pages alike.
+
+typedef enum {
+	SCAN_EQUALS,  // name or location equals value
+	SCAN_PREFIX,  // name or location starts with value
+	SCAN_ID_RANGE // low <= id <= high
+} scanOp;
+
+typedef struct scanPredicate {
+	scanOp op;
+	rowColumn column;  // COLUMN_NAME or COLUMN_LOCATION, SCAN_ID_RANGE ignores it
+	const char* value; // up to 64 bytes
+	int64_t low;       // SCAN_ID_RANGE bounds, both inclusive
+	int64_t high;
+} scanPredicate;
+
+typedef struct scanBatch {
+	uint32_t numRows;
+	int64_t ids[SCAN_BATCH_ROWS];
+	const char* names[SCAN_BATCH_ROWS];     // NAME_SIZE bytes each, inside the mapping
+	const char* locations[SCAN_BATCH_ROWS]; // LOCATION_SIZE bytes each
+	rowLocator locs[SCAN_BATCH_ROWS];
+} scanBatch;
+
+// selected holds the batch positions of the rows that passed, in file order.
+// The batch and the pointers in it are only valid during the call. Returning
+// false ends the scan, the rest of the file isn't read.
+typedef bool (*scanEmitFn)(const scanBatch* batch, const uint16_t* selected, uint32_t numSelected, void* arg);
+
+size_t scanFilter(mmapReader* reader, const scanPredicate* predicates, int numPredicates, scanEmitFn emit, void* arg);
+size_t scanFilterPages(mmapReader* reader, uint32_t first, uint32_t end, const scanPredicate* predicates,
+	int numPredicates, scanEmitFn emit, void* arg);
+void scanBatchRow(const scanBatch* batch, uint16_t i, struct Row* dOut);
+void scanUseSimd(bool enable);
@@ -0,0 +1,155 @@
+#include <inttypes.h>
+#include "secondaryIndex.h"
+#include "page.h"
+#include "mmapReader.h"
+// a second copy of bptree.h with string keys, kept static so it doesn't clash
+// with the int64 keyed one in bptree.o
+#define BPTREE_STATIC
+#define BPTREE_KEY_TYPE_STRING
+#define BPTREE_KEY_SIZE SECONDARY_KEY_SIZE
+#define BPTREE_IMPLEMENTATION
+#include "bptree.h"
+
+_Static_assert(NAME_SIZE == LOCATION_SIZE, "both columns share one key layout");
+
+static bptree* treeFor(secondaryIndexes* indexes, rowColumn column){
+	return column == COLUMN_NAME ? indexes->byName : indexes->byLocation;
+}
+
+// the column value, a zero byte, then the id in big endian with the sign bit
+// flipped, so memcmp orders rows by column value and rows with the same value
+// by id. Keys are only as long as the value plus nine bytes, which is what the
+// tree's prefix compression needs to store them in a few bytes each.
+static void makeKey(bptree_key_t* key, const char* value, int64_t id){
+	size_t len = strnlen(value, SECONDARY_COLUMN_SIZE);
+	memset(key->data, 0, sizeof(key->data));
+	memcpy(key->data, value, len);
+	uint64_t bits = (uint64_t)id ^ (1ULL << 63);
+	for (int i = sizeof(int64_t) - 1; i >= 0; i--){
+		key->data[len + 1 + i] = (char)(bits & 0xff);
+		bits >>= 8;
+	}
+}
+
+static int64_t keyId(const bptree_key_t* key){
+	size_t len = strnlen(key->data, SECONDARY_COLUMN_SIZE);
+	uint64_t bits = 0;
+	for (size_t i = 0; i < sizeof(int64_t); i++){
+		bits = bits << 8 | (uint8_t)key->data[len + 1 + i];
+	}
+	return (int64_t)(bits ^ (1ULL << 63));
+}
+
+secondaryIndexes* secondaryIndexesCreate(){
+	secondaryIndexes* indexes = calloc(1, sizeof(secondaryIndexes));
+	if (indexes == NULL){
+		printf("error allocating the secondary indexes exiting..");
+		exit(1);
+	}
+	indexes->byName = bptree_create(SECONDARY_MAX_KEYS, NULL, false);
+	indexes->byLocation = bptree_create(SECONDARY_MAX_KEYS, NULL, false);
+	if (indexes->byName == NULL || indexes->byLocation == NULL){
+		printf("error allocating the secondary indexes exiting..");
+		exit(1);
+	}
+	return indexes;
+}
+
+void secondaryIndexesFree(secondaryIndexes* indexes){
+	bptree_free(indexes->byName);
+	bptree_free(indexes->byLocation);
+	free(indexes);
+}
+
+static void addKey(bptree* tree, const char* value, int64_t id, rowLocator loc){
+	bptree_key_t key;
+	makeKey(&key, value, id);
+	// ids are unique, so the same key twice means the row was added twice
+	bptree_status status = bptree_put(tree, &key, loc);
+	if (status != BPTREE_OK && status != BPTREE_DUPLICATE_KEY){
+		printf("error adding id %ld to a secondary index exiting..", id);
+		exit(1);
+	}
+}
+
+void secondaryIndexesAdd(secondaryIndexes* indexes, const struct Row* row, rowLocator loc){
+	addKey(indexes->byName, row->name, row->id, loc);
+	addKey(indexes->byLocation, row->location, row->id, loc);
+}
+
+// Fills both trees from dbFile.bin with one sequential scan, like constructTree
+// does for the id index.
+void secondaryIndexesBuild(secondaryIndexes* indexes, int db){
+	printf("building the name and location indexes \n");
+	mmapReader* reader = mmapReaderOpen(db, MMAP_SEQUENTIAL);
+	uint32_t numPages = mmapReaderPages(reader);
+	for (uint32_t page_id = 0; page_id < numPages; page_id++){
+		const char* page = mmapReaderPage(reader, page_id);
+		for (uint16_t i = 0; i < pageNumSlots(page); i++){
+			rowLocator loc = {page_id, pageRowOffset(page, i)};
+			struct Row row;
+			pageReadRow(page, loc.offset, &row);
+			secondaryIndexesAdd(indexes, &row, loc);
+		}
+	}
+	mmapReaderClose(reader);
+	indexes->built = true;
+}
+
+// Calls match for every row whose column equals value, or starts with it when
+// prefix is set, in column then id order. Returns the number of matches.
+// The first key is the value followed by zero bytes. The last one is the value
+// then its zero byte and 0xff ids for equality, or the value then 0xff all the
+// way for a prefix so anything that continues the value is included.
+size_t secondaryIndexFind(secondaryIndexes* indexes, rowColumn column, const char* value, bool prefix,
+	secondaryMatchFn match, void* arg){
+	size_t len = strnlen(value, SECONDARY_COLUMN_SIZE);
+	bptree_key_t start;
+	bptree_key_t end;
+	memset(start.data, 0, sizeof(start.data));
+	memcpy(start.data, value, len);
+	memset(end.data, 0xff, sizeof(end.data));
+	memcpy(end.data, value, len);
+	if (!prefix){
+		end.data[len] = 0;
+	}
+	bptree_cursor cursor;
+	size_t found = 0;
+	if (bptree_cursor_seek(treeFor(indexes, column), &start, &end, &cursor) != BPTREE_OK){
+		return 0;
+	}
+	bptree_key_t key;
+	rowLocator loc;
+	while (bptree_cursor_next(&cursor, &key, &loc) == BPTREE_OK){
+		match(keyId(&key), loc, arg);
+		found++;
+	}
+	bptree_cursor_close(&cursor);
+	return found;
+}
+
+secondaryIndexStats secondaryIndexGetStats(secondaryIndexes* indexes, rowColumn column){
+	bptree_stats stats = bptree_get_stats(treeFor(indexes, column));
+	secondaryIndexStats out = {stats.height, stats.node_count, stats.bytes, stats.count,
+		stats.leaf_count, stats.internal_count, stats.leaf_bytes, stats.internal_bytes,
+		stats.fill_factor, stats.ops.descents, stats.ops.nodes_visited, stats.ops.est_comparisons,
+		stats.ops.splits, stats.ops.merges, stats.ops.borrows};
+	return out;
+}
+
+void secondaryIndexesPrintStats(secondaryIndexes* indexes){
+	if (!indexes->built){
+		printf("name and location indexes: not built yet, the first find builds them \n");
+		return;
+	}
+	for (int column = COLUMN_NAME; column <= COLUMN_LOCATION; column++){
+		secondaryIndexStats s = secondaryIndexGetStats(indexes, column);
+		printf("%s index: %d keys, height %d, %d leaves (%.1fKB), %d internal (%.1fKB), %.1fKB reserved, %.0f%% leaf fill \n",
+			column == COLUMN_NAME ? "name" : "location", s.count, s.height, s.leaves, s.leafBytes / 1024.0,
+			s.internals, s.internalBytes / 1024.0, s.bytes / 1024.0, 100.0 * s.fillFactor);
+		printf("  %" PRIu64 " descents, %.1f nodes and ~%.1f comparisons each, %" PRIu64 " splits, %" PRIu64
+			" merges, %" PRIu64 " borrows \n",
+			s.descents, s.descents ? (double)s.nodesVisited / s.descents : 0.0,
+			s.descents ? (double)s.estComparisons / s.descents : 0.0, s.splits, s.merges, s.borrows);
+	}
+}
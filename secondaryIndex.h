@@ -0,0 +1,55 @@
+#pragma once
+#include <stdbool.h>
+#include "db.h"
+
+#define SECONDARY_COLUMN_SIZE NAME_SIZE // name and location are both 64 bytes
+#define SECONDARY_KEY_SIZE (SECONDARY_COLUMN_SIZE + 1 + sizeof(int64_t))
+#define SECONDARY_MAX_KEYS 128 // keys pack into a few bytes each, so nodes can be wide
+
+// Secondary indexes on the name and location columns. Each one is an
+// in-memory bptree.h tree with fixed-size string keys: the column's value, a
+// zero byte and the row's id, so rows that share a name are separate keys that
+// sit next to each other in the leaves, and every key maps to the row's
+// locator. An equality or prefix lookup is one descent and a walk along the
+// leaves instead of a scan of dbFile.bin.
+// The trees aren't persisted. They are filled from the data file the first
+// time they're needed (secondaryIndexesBuild) and appendRows keeps them
+// current from then on.
+
+typedef struct secondaryIndexes {
+	void* byName;     // bptree with string keys, only secondaryIndex.c knows the layout
+	void* byLocation;
+	bool built;       // false until secondaryIndexesBuild, adds are skipped until then
+} secondaryIndexes;
+
+typedef void (*secondaryMatchFn)(int64_t id, rowLocator loc, void* arg);
+
+// bptree_get_stats() for one of the trees, all of it kept up as the tree
+// changes so asking is free. The operation counts are totals since the tree
+// was created.
+typedef struct secondaryIndexStats {
+	int height;
+	int nodes;
+	size_t bytes; // node and packed key memory the tree holds
+	int count;
+	int leaves;
+	int internals;
+	size_t leafBytes;
+	size_t internalBytes;
+	double fillFactor; // average share of leaf slots in use
+	uint64_t descents;
+	uint64_t nodesVisited;
+	uint64_t estComparisons; // one binary search's worth per node, not counted
+	uint64_t splits;
+	uint64_t merges;
+	uint64_t borrows;
+} secondaryIndexStats;
+
+secondaryIndexes* secondaryIndexesCreate();
+void secondaryIndexesFree(secondaryIndexes* indexes);
+void secondaryIndexesBuild(secondaryIndexes* indexes, int db);
+void secondaryIndexesAdd(secondaryIndexes* indexes, const struct Row* row, rowLocator loc);
+size_t secondaryIndexFind(secondaryIndexes* indexes, rowColumn column, const char* value, bool prefix,
+	secondaryMatchFn match, void* arg);
+secondaryIndexStats secondaryIndexGetStats(secondaryIndexes* indexes, rowColumn column);
+void secondaryIndexesPrintStats(secondaryIndexes* indexes);
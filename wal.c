@@ -0,0 +1,233 @@
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include "wal.h"
+
+static uint32_t crcTable[256];
+
+static void buildCrcTable(){
+	for (uint32_t i = 0; i < 256; i++){
+		uint32_t c = i;
+		for (int k = 0; k < 8; k++){
+			c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+		}
+		crcTable[i] = c;
+	}
+}
+
+static uint32_t crc32(uint32_t crc, const void* data, size_t len){
+	const unsigned char* p = data;
+	crc = ~crc;
+	for (size_t i = 0; i < len; i++){
+		crc = crcTable[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+static uint32_t recordChecksum(const walRecordHeader* header, const void* payload){
+	uint32_t crc = crc32(0, &header->lsn, sizeof(header->lsn));
+	crc = crc32(crc, &header->length, sizeof(header->length));
+	return crc32(crc, payload, header->length);
+}
+
+static void writeFileHeader(wal* log, uint64_t baseLsn){
+	walFileHeader header = {WAL_MAGIC, 0, baseLsn};
+	if (pwrite(log->fd, &header, sizeof(header), 0) != sizeof(header) || fsync(log->fd) != 0){
+		printf("error writing the WAL exiting..");
+		exit(1);
+	}
+}
+
+// Walks the valid prefix of the log, calling apply for every record when it
+// is given. Stops at the first torn or corrupt record, which marks the end of
+// what was ever acknowledged, and cuts the file back to there.
+static uint64_t walScan(wal* log, walReplayFn apply, void* arg){
+	walFileHeader fileHeader;
+	if (pread(log->fd, &fileHeader, sizeof(fileHeader), 0) != sizeof(fileHeader) ||
+			fileHeader.magic != WAL_MAGIC){
+		printf("%s is not a WAL file exiting..", PATH_TO_WAL);
+		exit(1);
+	}
+	uint64_t lsn = fileHeader.baseLsn;
+	off_t pos = sizeof(walFileHeader);
+	uint64_t applied = 0;
+	walRecordHeader header;
+	struct Row row;
+	while (pread(log->fd, &header, sizeof(header), pos) == sizeof(header)){
+		if (header.lsn != lsn || header.length != sizeof(struct Row)){
+			break;
+		}
+		if (pread(log->fd, &row, sizeof(row), pos + sizeof(header)) != sizeof(row)){
+			break;
+		}
+		if (recordChecksum(&header, &row) != header.checksum){
+			break;
+		}
+		if (apply != NULL){
+			apply(&row, arg);
+		}
+		applied++;
+		lsn++;
+		pos += sizeof(header) + sizeof(row);
+	}
+	if (ftruncate(log->fd, pos) != 0){
+		printf("error truncating the WAL exiting..");
+		exit(1);
+	}
+	log->end = pos;
+	log->nextLsn = lsn;
+	log->durableLsn = lsn - 1;
+	log->bufferedLsn = lsn - 1;
+	return applied;
+}
+
+wal* walOpen(char* filePath, size_t batchSize, uint32_t commitIntervalUs){
+	if (crcTable[1] == 0){
+		buildCrcTable();
+	}
+	wal* log = malloc(sizeof(wal));
+	if (log == NULL){
+		printf("error allocating the WAL exiting..");
+		exit(1);
+	}
+	log->fd = open(filePath, O_RDWR | O_CREAT, 0644);
+	if (log->fd < 0){
+		printf("error opening the WAL exiting..");
+		exit(1);
+	}
+	if (lseek(log->fd, 0, SEEK_END) < (off_t)sizeof(walFileHeader)){
+		writeFileHeader(log, 1);
+	}
+	log->batchSize = batchSize > 0 ? batchSize : 1;
+	log->commitIntervalUs = commitIntervalUs;
+	log->capacity = log->batchSize * (sizeof(walRecordHeader) + sizeof(struct Row));
+	log->spareCapacity = log->capacity;
+	log->buffer = malloc(log->capacity);
+	log->spare = malloc(log->spareCapacity);
+	if (log->buffer == NULL || log->spare == NULL){
+		printf("error allocating the WAL exiting..");
+		exit(1);
+	}
+	log->used = 0;
+	log->pending = 0;
+	log->flushing = false;
+	log->committers = 0;
+	log->fsyncs = 0;
+	pthread_mutex_init(&log->lock, NULL);
+	pthread_cond_init(&log->groupFull, NULL);
+	pthread_cond_init(&log->flushed, NULL);
+	walScan(log, NULL, NULL);
+	return log;
+}
+
+void walClose(wal* log){
+	walCommit(log, log->nextLsn - 1);
+	pthread_mutex_destroy(&log->lock);
+	pthread_cond_destroy(&log->groupFull);
+	pthread_cond_destroy(&log->flushed);
+	close(log->fd);
+	free(log->buffer);
+	free(log->spare);
+	free(log);
+}
+
+// Buffers one record and returns its lsn. The record is not durable until a
+// walCommit() covering that lsn returns.
+uint64_t walAppend(wal* log, const struct Row* row){
+	pthread_mutex_lock(&log->lock);
+	size_t need = sizeof(walRecordHeader) + sizeof(struct Row);
+	if (log->used + need > log->capacity){
+		log->capacity *= 2;
+		log->buffer = realloc(log->buffer, log->capacity);
+		if (log->buffer == NULL){
+			printf("error growing the WAL buffer exiting..");
+			exit(1);
+		}
+	}
+	walRecordHeader header;
+	header.lsn = log->nextLsn++;
+	header.length = sizeof(struct Row);
+	header.checksum = recordChecksum(&header, row);
+	memcpy(log->buffer + log->used, &header, sizeof(header));
+	memcpy(log->buffer + log->used + sizeof(header), row, sizeof(struct Row));
+	log->used += need;
+	log->pending++;
+	log->bufferedLsn = header.lsn;
+	if (log->pending >= log->batchSize){
+		pthread_cond_signal(&log->groupFull);
+	}
+	pthread_mutex_unlock(&log->lock);
+	return header.lsn;
+}
+
+// Blocks until every record up to lsn is on disk. The first committer to
+// find no flush in progress leads the next group, everyone else just waits
+// for the group their record ended up in. The leader only holds the group
+// open when someone else is committing too, there is nothing to wait for
+// otherwise.
+void walCommit(wal* log, uint64_t lsn){
+	pthread_mutex_lock(&log->lock);
+	log->committers++;
+	while (log->durableLsn < lsn){
+		if (log->flushing){
+			pthread_cond_wait(&log->flushed, &log->lock);
+			continue;
+		}
+		log->flushing = true;
+		if (log->pending < log->batchSize && log->commitIntervalUs > 0 && log->committers > 1){
+			struct timespec deadline;
+			clock_gettime(CLOCK_REALTIME, &deadline);
+			deadline.tv_nsec += (long)log->commitIntervalUs * 1000;
+			deadline.tv_sec += deadline.tv_nsec / 1000000000;
+			deadline.tv_nsec %= 1000000000;
+			pthread_cond_timedwait(&log->groupFull, &log->lock, &deadline);
+		}
+		char* group = log->buffer;
+		size_t groupBytes = log->used;
+		size_t groupCapacity = log->capacity;
+		uint64_t groupLsn = log->bufferedLsn;
+		off_t pos = log->end;
+		log->buffer = log->spare;
+		log->capacity = log->spareCapacity;
+		log->used = 0;
+		log->pending = 0;
+		log->end += groupBytes;
+		pthread_mutex_unlock(&log->lock);
+
+		if (groupBytes > 0 && (pwrite(log->fd, group, groupBytes, pos) != (ssize_t)groupBytes ||
+				fsync(log->fd) != 0)){
+			printf("error writing the WAL exiting..");
+			exit(1);
+		}
+
+		pthread_mutex_lock(&log->lock);
+		log->spare = group;
+		log->spareCapacity = groupCapacity;
+		log->durableLsn = groupLsn;
+		log->flushing = false;
+		log->fsyncs += groupBytes > 0;
+		pthread_cond_broadcast(&log->flushed);
+	}
+	log->committers--;
+	pthread_mutex_unlock(&log->lock);
+}
+
+// Feeds every durable record to apply, oldest first. Called once at startup
+// before anything else touches the data file.
+uint64_t walReplay(wal* log, walReplayFn apply, void* arg){
+	return walScan(log, apply, arg);
+}
+
+// Empties the log. Only safe once everything it covers has been fsynced to
+// dbFile.bin and index.bin. Lsns keep counting up across checkpoints.
+void walCheckpoint(wal* log){
+	walCommit(log, log->nextLsn - 1);
+	pthread_mutex_lock(&log->lock);
+	if (ftruncate(log->fd, 0) != 0){
+		printf("error truncating the WAL exiting..");
+		exit(1);
+	}
+	writeFileHeader(log, log->nextLsn);
+	log->end = sizeof(walFileHeader);
+	pthread_mutex_unlock(&log->lock);
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <pthread.h>
+#include <sys/types.h>
+#include <stdbool.h>
+#include "db.h"
+
+#define PATH_TO_WAL "wal.bin"
+#define WAL_MAGIC 0x004c4157 // "WAL"
+#define WAL_BATCH_SIZE 1024         // records that share one fsync
+#define WAL_COMMIT_INTERVAL_US 2000 // how long a commit waits for others to join its group
+
+// Write-ahead log for inserts. Every row is appended to wal.bin and made
+// durable before it touches dbFile.bin or index.bin, so a crash can always be
+// repaired by replaying the log. Records are fsynced in groups: a committer
+// becomes the group leader and, if other committers are waiting, waits up to
+// the commit interval (or until the batch is full) for their appends to pile
+// up, then writes and fsyncs them all at once while later committers wait for
+// the next group. A committer on its own fsyncs straight away.
+//
+// File layout: walFileHeader, then records of walRecordHeader + payload.
+
+typedef struct walFileHeader {
+	uint32_t magic;
+	uint32_t reserved;
+	uint64_t baseLsn; // lsn of the first record after the last checkpoint
+} walFileHeader;
+
+typedef struct walRecordHeader {
+	uint64_t lsn;
+	uint32_t length;   // payload bytes
+	uint32_t checksum; // crc32 over lsn, length and payload
+} walRecordHeader;
+
+typedef struct wal {
+	int fd;
+	off_t end;             // where the next group is written
+	uint64_t nextLsn;
+	uint64_t durableLsn;   // every lsn <= this is on disk
+	uint64_t bufferedLsn;  // last lsn sitting in buffer
+	char* buffer;          // records waiting for the next group commit
+	size_t used;
+	size_t capacity;
+	size_t pending;        // records in buffer
+	char* spare;           // swapped in while the leader writes the old buffer
+	size_t spareCapacity;
+	size_t batchSize;
+	uint32_t commitIntervalUs;
+	bool flushing;
+	uint32_t committers;   // threads inside walCommit, the leader included
+	pthread_mutex_t lock;
+	pthread_cond_t groupFull;
+	pthread_cond_t flushed;
+	uint64_t fsyncs;
+} wal;
+
+typedef void (*walReplayFn)(const struct Row* row, void* arg);
+
+wal* walOpen(char* filePath, size_t batchSize, uint32_t commitIntervalUs);
+void walClose(wal* log);
+uint64_t walAppend(wal* log, const struct Row* row);
+void walCommit(wal* log, uint64_t lsn);
+uint64_t walReplay(wal* log, walReplayFn apply, void* arg);
+void walCheckpoint(wal* log);